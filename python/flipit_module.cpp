@@ -0,0 +1,303 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bm_utils.h"
+#include "thread_pool.h"
+
+// Python bindings for the flipit library. Inputs are taken through the buffer
+// protocol (bytes, bytearray, memoryview, numpy arrays, ...) and read in place;
+// the heavy work runs with the GIL released, and the *_batch calls fan out over
+// the native thread pool.
+
+namespace {
+    // Owns a contiguous, byte-sized view of a Python object for the scope of a call.
+    class BufferView {
+    public:
+        BufferView() = default;
+        BufferView(const BufferView&) = delete;
+        BufferView& operator=(const BufferView&) = delete;
+        BufferView(BufferView&& other) noexcept : view(other.view), acquired(other.acquired) { other.acquired = false; }
+        ~BufferView() { if (acquired) PyBuffer_Release(&view); }
+
+        bool acquire(PyObject* object) {
+            if (PyObject_GetBuffer(object, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) return false;
+            acquired = true;
+            if (view.itemsize != 1) {
+                PyErr_SetString(PyExc_TypeError, "expected a buffer of bytes (itemsize 1)");
+                return false;
+            }
+            return true;
+        }
+
+        const uint8_t* data() const { return static_cast<const uint8_t*>(view.buf); }
+        size_t size() const { return static_cast<size_t>(view.len); }
+        int ndim() const { return view.ndim; }
+        Py_ssize_t shape(const int axis) const { return view.shape ? view.shape[axis] : view.len; }
+
+    private:
+        Py_buffer view{};
+        bool acquired = false;
+    };
+
+    // Runs fn with the GIL released. Exceptions are carried back across the
+    // boundary and raised as Python errors once the GIL is held again.
+    template <typename F>
+    bool runUnlocked(F&& fn) {
+        std::string error;
+        enum { None, Value, Memory } kind = None;
+        Py_BEGIN_ALLOW_THREADS
+        try {
+            fn();
+        } catch (const std::bad_alloc&) {
+            kind = Memory;
+        } catch (const std::exception& e) {
+            kind = Value;
+            error = e.what();
+        }
+        Py_END_ALLOW_THREADS
+        if (kind == Memory) PyErr_NoMemory();
+        else if (kind == Value) PyErr_SetString(PyExc_ValueError, error.c_str());
+        return kind == None;
+    }
+
+    PyObject* toBytes(const std::vector<uint8_t>& data) {
+        return PyBytes_FromStringAndSize(reinterpret_cast<const char*>(data.data()), static_cast<Py_ssize_t>(data.size()));
+    }
+
+    // Width and height come from the arguments or, for 2-D arrays, from the shape.
+    bool resolveDimensions(const BufferView& pixels, unsigned int& width, unsigned int& height) {
+        if (width == 0 && height == 0 && pixels.ndim() == 2) {
+            height = static_cast<unsigned int>(pixels.shape(0));
+            width = static_cast<unsigned int>(pixels.shape(1));
+        }
+        if (width == 0 || height == 0) {
+            PyErr_SetString(PyExc_ValueError, "width and height are required unless pixels is a 2-D array");
+            return false;
+        }
+        if (pixels.size() < static_cast<size_t>(width) * height) {
+            PyErr_SetString(PyExc_ValueError, "pixel buffer is smaller than width * height");
+            return false;
+        }
+        return true;
+    }
+
+    ThreadPool& defaultPool() {
+        // Created on first use (with the GIL held) and shared by all batch calls.
+        static ThreadPool pool;
+        return pool;
+    }
+
+    std::unique_ptr<ThreadPool> makePool(const unsigned int jobs) {
+        return jobs ? std::make_unique<ThreadPool>(jobs) : nullptr;
+    }
+
+    // Acquires every buffer of a sequence up front, so the workers never touch Python objects.
+    bool acquireAll(PyObject* sequence, std::vector<BufferView>& views, std::vector<PyObject*>* items = nullptr) {
+        PyObject* fast = PySequence_Fast(sequence, "expected a sequence of buffers");
+        if (!fast) return false;
+        const Py_ssize_t count = PySequence_Fast_GET_SIZE(fast);
+        views.resize(static_cast<size_t>(count));
+        bool ok = true;
+        for (Py_ssize_t i = 0; i < count && ok; ++i) {
+            PyObject* item = PySequence_Fast_GET_ITEM(fast, i);
+            if (items) items->push_back(item);
+            ok = views[i].acquire(item);
+        }
+        Py_DECREF(fast);
+        return ok;
+    }
+
+    PyObject* toList(const std::vector<std::vector<uint8_t>>& results) {
+        PyObject* list = PyList_New(static_cast<Py_ssize_t>(results.size()));
+        if (!list) return nullptr;
+        for (size_t i = 0; i < results.size(); ++i) {
+            PyObject* item = toBytes(results[i]);
+            if (!item) {
+                Py_DECREF(list);
+                return nullptr;
+            }
+            PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), item);
+        }
+        return list;
+    }
+
+    // Runs fn(i) for every item and reports the first failure with its index.
+    template <typename F>
+    bool runBatch(const size_t count, const unsigned int jobs, F&& fn) {
+        std::vector<std::string> errors(count);
+        const auto pool = makePool(jobs);
+        ThreadPool& workers = pool ? *pool : defaultPool();
+        const bool ok = runUnlocked([&] {
+            parallelFor(workers, count, [&](const size_t i) {
+                try {
+                    fn(i);
+                } catch (const std::bad_alloc&) {
+                    throw;
+                } catch (const std::exception& e) {
+                    errors[i] = e.what();
+                }
+            });
+        });
+        if (!ok) return false;
+        for (size_t i = 0; i < count; ++i) {
+            if (!errors[i].empty()) {
+                PyErr_Format(PyExc_ValueError, "item %zu: %s", i, errors[i].c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    PyObject* pyProbe(PyObject*, PyObject* args) {
+        PyObject* object;
+        if (!PyArg_ParseTuple(args, "O:probe", &object)) return nullptr;
+        BufferView bmx;
+        if (!bmx.acquire(object)) return nullptr;
+
+        BmxHeader header{};
+        try {
+            header = readBmxHeader(bmx.data(), bmx.size());
+        } catch (const std::exception& e) {
+            PyErr_SetString(PyExc_ValueError, e.what());
+            return nullptr;
+        }
+        return Py_BuildValue("{s:I,s:I,s:O,s:H}", "width", header.width, "height", header.height,
+                             "is_compressed", header.is_compressed ? Py_True : Py_False,
+                             "compressed_size", header.compressed_size);
+    }
+
+    PyObject* pyDecode(PyObject*, PyObject* args) {
+        PyObject* object;
+        if (!PyArg_ParseTuple(args, "O:decode", &object)) return nullptr;
+        BufferView bmx;
+        if (!bmx.acquire(object)) return nullptr;
+
+        BmxHeader header{};
+        std::vector<uint8_t> bits;
+        if (!runUnlocked([&] { bits = decodeBMX(bmx.data(), bmx.size(), header); })) return nullptr;
+
+        PyObject* data = toBytes(bits);
+        if (!data) return nullptr;
+        return Py_BuildValue("(NII)", data, header.width, header.height);
+    }
+
+    PyObject* pyEncode(PyObject*, PyObject* args, PyObject* kwargs) {
+        static const char* keywords[] = {"pixels", "width", "height", nullptr};
+        PyObject* object;
+        unsigned int width = 0, height = 0;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|II:encode", const_cast<char**>(keywords), &object, &width, &height))
+            return nullptr;
+        BufferView pixels;
+        if (!pixels.acquire(object) || !resolveDimensions(pixels, width, height)) return nullptr;
+
+        std::vector<uint8_t> file;
+        if (!runUnlocked([&] { file = encodeBMX(pixels.data(), width, height); })) return nullptr;
+        return toBytes(file);
+    }
+
+    PyObject* pyExpand(PyObject*, PyObject* args) {
+        PyObject* object;
+        unsigned int width, height;
+        if (!PyArg_ParseTuple(args, "OII:expand", &object, &width, &height)) return nullptr;
+        BufferView bits;
+        if (!bits.acquire(object)) return nullptr;
+
+        std::vector<uint8_t> pixels;
+        if (!runUnlocked([&] { pixels = expandBitData(bits.data(), bits.size(), width, height); })) return nullptr;
+        return toBytes(pixels);
+    }
+
+    PyObject* pyPack(PyObject*, PyObject* args, PyObject* kwargs) {
+        static const char* keywords[] = {"pixels", "width", "height", nullptr};
+        PyObject* object;
+        unsigned int width = 0, height = 0;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|II:pack", const_cast<char**>(keywords), &object, &width, &height))
+            return nullptr;
+        BufferView pixels;
+        if (!pixels.acquire(object) || !resolveDimensions(pixels, width, height)) return nullptr;
+
+        std::vector<uint8_t> bits;
+        if (!runUnlocked([&] { bits = convertToBitData(pixels.data(), width, height); })) return nullptr;
+        return toBytes(bits);
+    }
+
+    PyObject* pyDecodeBatch(PyObject*, PyObject* args, PyObject* kwargs) {
+        static const char* keywords[] = {"files", "jobs", nullptr};
+        PyObject* sequence;
+        unsigned int jobs = 0;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|I:decode_batch", const_cast<char**>(keywords), &sequence, &jobs))
+            return nullptr;
+        std::vector<BufferView> files;
+        if (!acquireAll(sequence, files)) return nullptr;
+
+        std::vector<std::vector<uint8_t>> results(files.size());
+        const bool ok = runBatch(files.size(), jobs, [&](const size_t i) {
+            BmxHeader header{};
+            results[i] = decodeBMX(files[i].data(), files[i].size(), header);
+        });
+        return ok ? toList(results) : nullptr;
+    }
+
+    PyObject* pyEncodeBatch(PyObject*, PyObject* args, PyObject* kwargs) {
+        static const char* keywords[] = {"images", "width", "height", "jobs", nullptr};
+        PyObject* sequence;
+        unsigned int width = 0, height = 0, jobs = 0;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|III:encode_batch", const_cast<char**>(keywords),
+                                         &sequence, &width, &height, &jobs))
+            return nullptr;
+        std::vector<BufferView> images;
+        if (!acquireAll(sequence, images)) return nullptr;
+
+        std::vector<std::pair<unsigned int, unsigned int>> sizes(images.size(), {width, height});
+        for (size_t i = 0; i < images.size(); ++i)
+            if (!resolveDimensions(images[i], sizes[i].first, sizes[i].second)) return nullptr;
+
+        std::vector<std::vector<uint8_t>> results(images.size());
+        const bool ok = runBatch(images.size(), jobs, [&](const size_t i) {
+            results[i] = encodeBMX(images[i].data(), sizes[i].first, sizes[i].second);
+        });
+        return ok ? toList(results) : nullptr;
+    }
+
+    PyMethodDef methods[] = {
+        {"probe", pyProbe, METH_VARARGS,
+         "probe(bmx) -> dict\n\nParse a BMX header without decoding the image."},
+        {"decode", pyDecode, METH_VARARGS,
+         "decode(bmx) -> (bits, width, height)\n\nDecode a BMX file to packed bits (LSB-first, set bit = black)."},
+        {"encode", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(pyEncode)), METH_VARARGS | METH_KEYWORDS,
+         "encode(pixels, width=0, height=0) -> bytes\n\n8-bit grayscale pixels to BMX file bytes. "
+         "Dimensions default to the shape of a 2-D array."},
+        {"expand", pyExpand, METH_VARARGS,
+         "expand(bits, width, height) -> bytes\n\nPacked bits to 8-bit grayscale pixels (black 0, white 255)."},
+        {"pack", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(pyPack)), METH_VARARGS | METH_KEYWORDS,
+         "pack(pixels, width=0, height=0) -> bytes\n\n8-bit grayscale pixels to packed bits (pixel < 128 is black)."},
+        {"decode_batch", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(pyDecodeBatch)), METH_VARARGS | METH_KEYWORDS,
+         "decode_batch(files, jobs=0) -> list[bytes]\n\nDecode many BMX files in parallel without holding the GIL."},
+        {"encode_batch", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(pyEncodeBatch)), METH_VARARGS | METH_KEYWORDS,
+         "encode_batch(images, width=0, height=0, jobs=0) -> list[bytes]\n\nEncode many images in parallel without holding the GIL."},
+        {nullptr, nullptr, 0, nullptr},
+    };
+
+    PyModuleDef module = {
+        PyModuleDef_HEAD_INIT,
+        "flipit",
+        "Flipper BMX image encoding and decoding.",
+        -1,
+        methods,
+    };
+}
+
+PyMODINIT_FUNC PyInit_flipit(void) {
+    PyObject* m = PyModule_Create(&module);
+    if (!m) return nullptr;
+    PyModule_AddIntConstant(m, "WINDOW_BITS", WINDOW_BITS);
+    PyModule_AddIntConstant(m, "LOOKAHEAD_BITS", LOOKAHEAD_BITS);
+    return m;
+}
@@ -0,0 +1,26 @@
+#include "bit_reverse.h"
+
+#include <cstring>
+
+void reverseBits(const uint8_t* in, uint8_t* out, const size_t size, const uint8_t invert) {
+    // Eight bytes per step: swap adjacent bits, then bit pairs, then nibbles.
+    // The loop is plain 64-bit arithmetic, which the compiler vectorizes.
+    const uint64_t invert_word = invert * 0x0101010101010101ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t x;
+        std::memcpy(&x, in + i, 8);
+        x = (x >> 1 & 0x5555555555555555ull) | (x & 0x5555555555555555ull) << 1;
+        x = (x >> 2 & 0x3333333333333333ull) | (x & 0x3333333333333333ull) << 2;
+        x = (x >> 4 & 0x0F0F0F0F0F0F0F0Full) | (x & 0x0F0F0F0F0F0F0F0Full) << 4;
+        x ^= invert_word;
+        std::memcpy(out + i, &x, 8);
+    }
+    for (; i < size; ++i) {
+        uint32_t x = in[i];
+        x = (x >> 1 & 0x55) | (x & 0x55) << 1;
+        x = (x >> 2 & 0x33) | (x & 0x33) << 2;
+        x = (x >> 4 & 0x0F) | (x & 0x0F) << 4;
+        out[i] = static_cast<uint8_t>(x ^ invert);
+    }
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// PNG and PBM pack pixels MSB-first, BMX LSB-first. Reverses the bit order of
+// every byte, then XORs it with invert (0xFF flips black and white). in and
+// out may be the same buffer.
+void reverseBits(const uint8_t* in, uint8_t* out, size_t size, uint8_t invert = 0);
@@ -0,0 +1,109 @@
+#include "bm_analyze.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+namespace {
+    class BitReader {
+    public:
+        BitReader(const uint8_t* data, const size_t size) : data(data), total_bits(size * 8) {}
+
+        size_t remaining() const { return total_bits - position; }
+
+        uint32_t read(const uint8_t count) {
+            uint32_t value = 0;
+            for (uint8_t i = 0; i < count; ++i) {
+                const uint8_t bit = (data[position / 8] >> (7 - position % 8)) & 1;
+                value = (value << 1) | bit;
+                ++position;
+            }
+            return value;
+        }
+
+        bool peek() const {
+            return (data[position / 8] >> (7 - position % 8)) & 1;
+        }
+
+    private:
+        const uint8_t* data;
+        size_t total_bits;
+        size_t position = 0;
+    };
+
+    // Approximate cycle weights for the cost model. They only need to rank
+    // assets against each other, not predict exact frame times.
+    constexpr uint64_t CYCLES_PER_BIT = 14;
+    constexpr uint64_t CYCLES_PER_TOKEN = 40;
+    constexpr uint64_t CYCLES_PER_BYTE = 12;
+}
+
+HeatshrinkStats analyzeHeatshrink(const uint8_t* input, const size_t input_size, const uint8_t window_bits, const uint8_t lookahead_bits) {
+    HeatshrinkStats stats{};
+    stats.window_bits = window_bits;
+    stats.lookahead_bits = lookahead_bits;
+    stats.input_bytes = input_size;
+    stats.distance_histogram.assign((size_t{1} << window_bits) + 1, 0);
+    stats.length_histogram.assign((size_t{1} << lookahead_bits) + 1, 0);
+
+    const size_t literal_token_bits = 1 + 8;
+    const size_t backref_token_bits = 1 + window_bits + lookahead_bits;
+
+    BitReader reader(input, input_size);
+    size_t literal_run = 0;
+
+    while (reader.remaining() > 0) {
+        const bool is_literal = reader.peek();
+        if (reader.remaining() < (is_literal ? literal_token_bits : backref_token_bits)) break;
+        reader.read(1);
+
+        if (is_literal) {
+            reader.read(8);
+            ++stats.literal_count;
+            stats.literal_bits += literal_token_bits;
+            ++stats.output_bytes;
+            stats.longest_literal_run = std::max(stats.longest_literal_run, ++literal_run);
+        } else {
+            const size_t distance = reader.read(window_bits) + 1;
+            const size_t length = reader.read(lookahead_bits) + 1;
+            ++stats.backref_count;
+            stats.backref_bits += backref_token_bits;
+            ++stats.distance_histogram[distance];
+            ++stats.length_histogram[length];
+            if (distance > stats.output_bytes) ++stats.prestart_refs;
+            stats.backref_bytes += length;
+            stats.output_bytes += length;
+            literal_run = 0;
+        }
+    }
+
+    stats.padding_bits = reader.remaining();
+    return stats;
+}
+
+DecodeCost estimateDecodeCost(const HeatshrinkStats& stats) {
+    DecodeCost cost{};
+    cost.bits_read = stats.literal_bits + stats.backref_bits;
+    cost.tokens = stats.literal_count + stats.backref_count;
+    cost.bytes_written = stats.output_bytes;
+    cost.cycles = cost.bits_read * CYCLES_PER_BIT + cost.tokens * CYCLES_PER_TOKEN + cost.bytes_written * CYCLES_PER_BYTE;
+    cost.micros = static_cast<double>(cost.cycles) * 1e6 / DEVICE_CPU_HZ;
+    return cost;
+}
+
+std::vector<uint8_t> readHeatshrinkStream(const std::string& path, size_t& raw_size) {
+    const auto file = readFile(path);
+
+    StoredData data{};
+    if (std::filesystem::path(path).extension() == ".bm") {
+        data = locateBMData(file);
+        raw_size = data.is_compressed ? 0 : data.size;
+    } else {
+        const BmxHeader header = readBmxHeader(file);
+        raw_size = static_cast<size_t>((header.width + 7) / 8) * header.height;
+        data = locateBMXData(header, file.size());
+    }
+    if (!data.is_compressed) return {};
+    const auto begin = file.begin() + static_cast<std::ptrdiff_t>(data.offset);
+    return {begin, begin + static_cast<std::ptrdiff_t>(data.size)};
+}
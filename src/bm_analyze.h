@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bm_utils.h"
+
+// Token-level statistics of a heatshrink stream, gathered by walking the
+// bitstream the same way the decoder does.
+struct HeatshrinkStats {
+    uint8_t window_bits;
+    uint8_t lookahead_bits;
+
+    size_t input_bytes = 0;
+    size_t output_bytes = 0;
+
+    size_t literal_count = 0;
+    size_t backref_count = 0;
+    size_t literal_bits = 0;
+    size_t backref_bits = 0;
+    size_t padding_bits = 0;
+
+    size_t backref_bytes = 0;      // bytes produced by back-references
+    size_t prestart_refs = 0;      // back-references reaching into the zeroed window
+    size_t longest_literal_run = 0;
+
+    std::vector<size_t> distance_histogram; // [d] = back-references with distance d, 1..2^window_bits
+    std::vector<size_t> length_histogram;   // [n] = back-references copying n bytes, 1..2^lookahead_bits
+};
+
+// Rough decoder cost on the device (Cortex-M4 at 64 MHz). heatshrink reads the
+// stream one bit at a time and runs its state machine once per token, so the
+// model charges per bit read, per token and per output byte.
+struct DecodeCost {
+    size_t bits_read;
+    size_t tokens;
+    size_t bytes_written;
+    uint64_t cycles;
+    double micros;
+};
+
+constexpr uint32_t DEVICE_CPU_HZ = 64000000;
+
+HeatshrinkStats analyzeHeatshrink(const uint8_t* input, size_t input_size,
+                                  uint8_t window_bits = WINDOW_BITS, uint8_t lookahead_bits = LOOKAHEAD_BITS);
+DecodeCost estimateDecodeCost(const HeatshrinkStats& stats);
+
+// Returns the heatshrink payload of a .bmx or .bm file, or an empty vector
+// when the file is stored uncompressed. raw_size receives the unpacked size
+// when the container records it, 0 otherwise.
+std::vector<uint8_t> readHeatshrinkStream(const std::string& path, size_t& raw_size);
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+#include "bm_utils.h"
+#include "heatshrink_codec.h"
+
+// Compile-time decoding of embedded BMX assets. Everything here is constexpr,
+// so an icon stored as a compressed byte array can be unpacked by the compiler:
+//
+//     constexpr uint8_t lock_bmx[] = { ... };
+//     constexpr auto lock_bits = decodeBmxStatic<bmxPackedSize(lock_bmx)>(lock_bmx);
+//
+// or, where the result need not be constexpr itself, decodeBmxConsteval.
+// A malformed header or stream fails the constant evaluation, i.e. the build.
+// The same functions also run at runtime, so the compressed array can be kept
+// and decoded on demand when binary size matters more than startup time.
+
+struct BmxInfo {
+    uint32_t width;
+    uint32_t height;
+    bool     is_compressed;
+    uint16_t compressed_size;
+    size_t   data_offset;
+    size_t   data_size;
+};
+
+namespace bm_constexpr_detail {
+    constexpr uint32_t readLe32(const std::span<const uint8_t> data, const size_t offset) {
+        return static_cast<uint32_t>(data[offset]) | static_cast<uint32_t>(data[offset + 1]) << 8 |
+               static_cast<uint32_t>(data[offset + 2]) << 16 | static_cast<uint32_t>(data[offset + 3]) << 24;
+    }
+}
+
+// Same layout and checks as LoadBMX, without memcpy into the packed structs.
+constexpr BmxInfo parseBmxHeader(const std::span<const uint8_t> file) {
+    if (file.size() < sizeof(UncompressedBmxHeader))
+        throw std::runtime_error("File too small for header");
+
+    BmxInfo info{};
+    info.width = bm_constexpr_detail::readLe32(file, 0);
+    info.height = bm_constexpr_detail::readLe32(file, 4);
+    info.is_compressed = file[8] != 0;
+
+    if (info.is_compressed) {
+        if (file.size() < sizeof(CompressedBmxHeader))
+            throw std::runtime_error("Truncated compressed header");
+        info.compressed_size = static_cast<uint16_t>(file[10] | file[11] << 8);
+        info.data_offset = sizeof(CompressedBmxHeader);
+        info.data_size = info.compressed_size;
+        if (info.data_offset + info.data_size > file.size())
+            throw std::runtime_error("Compressed data overflow");
+    } else {
+        info.data_offset = sizeof(UncompressedBmxHeader);
+        info.data_size = file.size() - info.data_offset;
+    }
+    return info;
+}
+
+constexpr size_t packedSize(const uint32_t width, const uint32_t height) {
+    return static_cast<size_t>((width + 7) / 8) * height;
+}
+
+constexpr size_t bmxPackedSize(const std::span<const uint8_t> file) {
+    const BmxInfo info = parseBmxHeader(file);
+    return packedSize(info.width, info.height);
+}
+
+template <size_t OutputSize, uint8_t WindowBits = WINDOW_BITS, uint8_t LookaheadBits = LOOKAHEAD_BITS>
+constexpr std::array<uint8_t, OutputSize> decompressHeatshrinkStatic(const std::span<const uint8_t> input) {
+    std::array<uint8_t, OutputSize> output{};
+    const size_t written = HeatshrinkCodec<WindowBits, LookaheadBits>::decompressInto(input.data(), input.size(), output.data(), output.size());
+    if (written != OutputSize) throw std::runtime_error("heatshrink stream is shorter than expected");
+    return output;
+}
+
+// Packed LSB-first bits of a BMX file, exactly what LoadBMX returns.
+template <size_t PackedSize>
+constexpr std::array<uint8_t, PackedSize> decodeBmxStatic(const std::span<const uint8_t> file) {
+    const BmxInfo info = parseBmxHeader(file);
+    if (packedSize(info.width, info.height) != PackedSize)
+        throw std::runtime_error("BMX dimensions do not match the requested size");
+
+    const auto payload = file.subspan(info.data_offset, info.data_size);
+    if (info.is_compressed) return decompressHeatshrinkStatic<PackedSize>(payload);
+
+    if (payload.size() < PackedSize) throw std::runtime_error("Truncated BMX data");
+    std::array<uint8_t, PackedSize> output{};
+    for (size_t i = 0; i < PackedSize; ++i) output[i] = payload[i];
+    return output;
+}
+
+// decodeBmxStatic that can only run in the compiler, so even a non-constexpr
+// variable it initializes costs no startup decode.
+template <size_t PackedSize>
+consteval std::array<uint8_t, PackedSize> decodeBmxConsteval(const std::span<const uint8_t> file) {
+    return decodeBmxStatic<PackedSize>(file);
+}
+
+// Pixel accessors over packed bits, matching expandBitData: set bit = black.
+constexpr bool bmxPixelIsBlack(const std::span<const uint8_t> bits, const uint32_t width, const uint32_t x, const uint32_t y) {
+    const size_t index = y * ((width + 7) / 8) + x / 8;
+    return index < bits.size() && (bits[index] >> (x % 8) & 1) != 0;
+}
+
+template <uint32_t Width, uint32_t Height>
+constexpr std::array<uint8_t, static_cast<size_t>(Width) * Height> expandBitDataStatic(const std::span<const uint8_t> bits) {
+    std::array<uint8_t, static_cast<size_t>(Width) * Height> pixels{};
+    for (uint32_t y = 0; y < Height; ++y)
+        for (uint32_t x = 0; x < Width; ++x)
+            pixels[y * Width + x] = bmxPixelIsBlack(bits, Width, x, y) ? 0 : 255;
+    return pixels;
+}
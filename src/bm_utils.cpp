@@ -1,4 +1,9 @@
 #include "bm_utils.h"
+#include "flip_optimizer.h"
+#include "heatshrink_codec.h"
+#include "luma.h"
+#include "png_reader.h"
+#include "trace.h"
 
 #include <fstream>
 #include <iostream>
@@ -10,6 +15,9 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+// PNG deflate goes through the library's chunked, multi-threaded compressor.
+#include "deflate.h"
+#define STBIW_ZLIB_COMPRESS zlibCompressForStb
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
@@ -18,7 +26,10 @@ extern "C" {
 #include "heatshrink_encoder.h"
 }
 
+using DefaultHeatshrinkCodec = HeatshrinkCodec<WINDOW_BITS, LOOKAHEAD_BITS>;
+
 std::vector<uint8_t> readFile(const std::string& path) {
+    TraceScope trace("read");
     std::ifstream f(path, std::ios::binary | std::ios::ate);
     if (!f) throw std::runtime_error("Failed to open file: " + path);
 
@@ -32,10 +43,18 @@ std::vector<uint8_t> readFile(const std::string& path) {
     return buffer;
 }
 
-std::vector<uint8_t> decompressHeatshrink(const uint8_t* input, const size_t input_size) {
+std::vector<uint8_t> decompressHeatshrink(const uint8_t* input, const size_t input_size, const uint8_t window_bits, const uint8_t lookahead_bits) {
+    TraceScope trace("decompress");
+    if (window_bits == WINDOW_BITS && lookahead_bits == LOOKAHEAD_BITS)
+        return DefaultHeatshrinkCodec::decompress(input, input_size);
+    return decompressHeatshrinkLibrary(input, input_size, window_bits, lookahead_bits);
+}
+
+std::vector<uint8_t> decompressHeatshrinkLibrary(const uint8_t* input, const size_t input_size, const uint8_t window_bits,
+                                                 const uint8_t lookahead_bits) {
     constexpr uint16_t INPUT_BUFFER_SIZE = 256;
 
-    heatshrink_decoder* dec = heatshrink_decoder_alloc(INPUT_BUFFER_SIZE, WINDOW_BITS, LOOKAHEAD_BITS);
+    heatshrink_decoder* dec = heatshrink_decoder_alloc(INPUT_BUFFER_SIZE, window_bits, lookahead_bits);
     if (!dec) throw std::runtime_error("Failed to allocate heatshrink decoder");
 
     std::vector<uint8_t> output;
@@ -111,8 +130,16 @@ std::vector<uint8_t> decompressHeatshrink(const uint8_t* input, const size_t inp
     return output;
 }
 
-std::vector<uint8_t> compressHeatshrink(const uint8_t* input, const size_t input_size) {
-    heatshrink_encoder* enc = heatshrink_encoder_alloc(WINDOW_BITS, LOOKAHEAD_BITS);
+std::vector<uint8_t> compressHeatshrink(const uint8_t* input, const size_t input_size, const uint8_t window_bits, const uint8_t lookahead_bits) {
+    TraceScope trace("compress");
+    if (window_bits == WINDOW_BITS && lookahead_bits == LOOKAHEAD_BITS)
+        return DefaultHeatshrinkCodec::compress(input, input_size);
+    return compressHeatshrinkLibrary(input, input_size, window_bits, lookahead_bits);
+}
+
+std::vector<uint8_t> compressHeatshrinkLibrary(const uint8_t* input, const size_t input_size, const uint8_t window_bits,
+                                               const uint8_t lookahead_bits) {
+    heatshrink_encoder* enc = heatshrink_encoder_alloc(window_bits, lookahead_bits);
     if (!enc) throw std::runtime_error("Failed to allocate heatshrink encoder");
 
     std::vector<uint8_t> output;
@@ -158,66 +185,108 @@ std::vector<uint8_t> compressHeatshrink(const uint8_t* input, const size_t input
     return output;
 }
 
-std::vector<uint8_t> LoadBM(const std::string& path) {
-    auto file = readFile(path);
+StoredData locateBMData(const std::vector<uint8_t>& file) {
     if (file.empty()) throw std::runtime_error("Empty BM file");
+    if (file[0] == 0x00) return {false, 1, file.size() - 1};
+    if (file[0] != 0x01) throw std::runtime_error("Unknown compression flag");
+
+    // Reserved byte, then the stream length as a little-endian uint16.
+    if (file.size() < 4) throw std::runtime_error("Truncated compressed length field");
+    const size_t comp_len = static_cast<size_t>(file[2]) | static_cast<size_t>(file[3]) << 8;
+    if (4 + comp_len > file.size()) throw std::runtime_error("Compressed data overflow");
+    return {true, 4, comp_len};
+}
+
+std::vector<uint8_t> decodeBM(const std::vector<uint8_t>& file) {
+    const StoredData data = locateBMData(file);
+    const uint8_t* begin = file.data() + data.offset;
+    if (data.is_compressed) return decompressHeatshrink(begin, data.size);
+    return {begin, begin + data.size};
+}
+
+std::vector<uint8_t> compressedBMFrame(const uint8_t* stream, const size_t size) {
+    if (size > MAX_COMPRESSED_SIZE) throw std::runtime_error("Compressed stream too long for a .bm frame");
+    // A reserved byte and the little-endian 16-bit stream length, as the
+    // firmware reads them.
+    std::vector<uint8_t> frame{0x01, 0x00, static_cast<uint8_t>(size & 0xFF), static_cast<uint8_t>(size >> 8)};
+    frame.insert(frame.end(), stream, stream + size);
+    return frame;
+}
+
+std::vector<uint8_t> encodeBM(const std::vector<uint8_t>& bitData) {
+    const std::vector<uint8_t> compressedData = compressHeatshrink(bitData.data(), bitData.size());
 
-    const uint8_t flag = file[0];
-    std::vector<uint8_t> result;
-
-    if (flag == 0x00) {
-        std::cout << "Uncompressed BM data\n";
-        result.assign(file.begin() + 1, file.end());
-    } else if (flag == 0x01) {
-        std::cout << "Compressed BM data\n";
-        if (file.size() < 5) throw std::runtime_error("Truncated compressed length field");
-        const uint32_t comp_len = (static_cast<uint32_t>(file[1]) << 8) | static_cast<uint32_t>(file[2]) << 0;
-        if (1 + comp_len > file.size()) throw std::runtime_error("Compressed data overflow");
-        result = decompressHeatshrink(&file[4], comp_len);
+    std::vector<uint8_t> frame;
+    if (compressedData.size() <= MAX_COMPRESSED_SIZE && compressedData.size() + 4 < bitData.size() + 1) {
+        frame = compressedBMFrame(compressedData.data(), compressedData.size());
     } else {
-        throw std::runtime_error("Unknown compression flag");
+        frame = {0x00};
+        frame.insert(frame.end(), bitData.begin(), bitData.end());
     }
+    return frame;
+}
 
-    return result;
+std::vector<uint8_t> LoadBM(const std::string& path) {
+    const auto file = readFile(path);
+    if (!file.empty() && file[0] == 0x00) std::cout << "Uncompressed BM data\n";
+    else if (!file.empty() && file[0] == 0x01) std::cout << "Compressed BM data\n";
+    return decodeBM(file);
 }
 
-std::vector<uint8_t> LoadBMX(const std::string& path, BmxHeader& header) {
-    auto file = readFile(path);
-    if (file.size() < sizeof(UncompressedBmxHeader))
+BmxHeader readBmxHeader(const uint8_t* file, const size_t file_size) {
+    if (file_size < sizeof(UncompressedBmxHeader))
         throw std::runtime_error("File too small for header");
 
     UncompressedBmxHeader base{};
-    std::memcpy(&base, file.data(), sizeof(base));
+    std::memcpy(&base, file, sizeof(base));
 
+    BmxHeader header{};
     header.width = base.width;
     header.height = base.height;
     header.is_compressed = base.is_compressed;
     header.compressed_size = 0;
 
-    std::vector<uint8_t> result;
-
     if (header.is_compressed) {
-        if (file.size() < sizeof(CompressedBmxHeader))
+        if (file_size < sizeof(CompressedBmxHeader))
             throw std::runtime_error("Truncated compressed header");
 
         CompressedBmxHeader ch{};
-        std::memcpy(&ch, file.data(), sizeof(ch));
+        std::memcpy(&ch, file, sizeof(ch));
         header.compressed_size = ch.compressed_size;
 
-        constexpr size_t offset = sizeof(CompressedBmxHeader);
-        if (offset + header.compressed_size > file.size())
+        if (sizeof(CompressedBmxHeader) + header.compressed_size > file_size)
             throw std::runtime_error("Compressed data overflow");
-
-        result = decompressHeatshrink(file.data() + offset, header.compressed_size);
-    } else {
-        constexpr size_t offset = sizeof(UncompressedBmxHeader);
-        result.assign(file.begin() + offset, file.end());
     }
 
-    return result;
+    return header;
 }
 
-std::vector<uint8_t> expandBitData(const std::vector<uint8_t>& bitData, const uint32_t width, const uint32_t height) {
+BmxHeader readBmxHeader(const std::vector<uint8_t>& file) {
+    return readBmxHeader(file.data(), file.size());
+}
+
+StoredData locateBMXData(const BmxHeader& header, const size_t file_size) {
+    if (header.is_compressed) return {true, sizeof(CompressedBmxHeader), header.compressed_size};
+    return {false, sizeof(UncompressedBmxHeader), file_size - sizeof(UncompressedBmxHeader)};
+}
+
+std::vector<uint8_t> decodeBMX(const uint8_t* file, const size_t file_size, BmxHeader& header) {
+    header = readBmxHeader(file, file_size);
+    const StoredData data = locateBMXData(header, file_size);
+    if (data.is_compressed) return decompressHeatshrink(file + data.offset, data.size);
+    return {file + data.offset, file + data.offset + data.size};
+}
+
+std::vector<uint8_t> decodeBMX(const std::vector<uint8_t>& file, BmxHeader& header) {
+    return decodeBMX(file.data(), file.size(), header);
+}
+
+std::vector<uint8_t> LoadBMX(const std::string& path, BmxHeader& header) {
+    return decodeBMX(readFile(path), header);
+}
+
+std::vector<uint8_t> expandBitData(const uint8_t* bitData, const size_t bitDataSize, const uint32_t width, const uint32_t height) {
+    TraceScope trace("unpack");
     std::vector<uint8_t> pixels(width * height);
     const size_t bytes_per_row = (width + 7) / 8;
 
@@ -225,7 +294,7 @@ std::vector<uint8_t> expandBitData(const std::vector<uint8_t>& bitData, const ui
         for (uint32_t x = 0; x < width; ++x) {
             const size_t byteIndex = y * bytes_per_row + (x / 8);
             const uint8_t mask = 1 << (x % 8);
-            if (byteIndex >= bitData.size()) {
+            if (byteIndex >= bitDataSize) {
                 pixels[y * width + x] = 255;
                 continue;
             }
@@ -236,28 +305,77 @@ std::vector<uint8_t> expandBitData(const std::vector<uint8_t>& bitData, const ui
     return pixels;
 }
 
+std::vector<uint8_t> expandBitData(const std::vector<uint8_t>& bitData, const uint32_t width, const uint32_t height) {
+    return expandBitData(bitData.data(), bitData.size(), width, height);
+}
+
 std::vector<uint8_t> convertToBitData(const uint8_t* data, const uint32_t width, const uint32_t height) {
-    const size_t bytes_per_row = (width + 7) / 8;
-    std::vector<uint8_t> bitData(bytes_per_row * height, 0);
+    return convertToBitData(data, width, height, 1);
+}
 
-    for (uint32_t y = 0; y < height; ++y) {
-        for (uint32_t x = 0; x < width; ++x) {
-            const uint8_t pixel = data[y * width + x];
-            const bool is_black = pixel < 128;
-            if (is_black)
-                bitData[y * bytes_per_row + (x / 8)] |= (1 << (x % 8));
-        }
+namespace {
+    void applyFlipBudget(std::vector<uint8_t>& bits, const uint32_t width, const uint32_t height, const ConvertOptions& options,
+                         ConvertStats* stats) {
+        if (options.max_flips == 0) return;
+        const FlipResult flips = optimizePixelFlips(bits, width, height, options.max_flips);
+        if (!stats) return;
+        // Size of the BMX encodePackedBMX writes, raw fallback included.
+        const auto fileSize = [raw = bits.size()](const size_t stream_bits) {
+            const size_t compressed = (stream_bits + 7) / 8;
+            return storesCompressed(compressed, raw) ? sizeof(CompressedBmxHeader) + compressed : sizeof(UncompressedBmxHeader) + raw;
+        };
+        stats->pixels_flipped = flips.pixels_changed;
+        stats->bytes_saved = fileSize(flips.bits_before) - fileSize(flips.bits_after);
     }
-    return bitData;
 }
 
-bool writeBmx(const std::string& path, const uint8_t* pixels, const uint32_t width, const uint32_t height) {
-    std::ofstream f(path, std::ios::binary);
-    if (!f) return false;
+ResizeTarget outputSize(const ConvertOptions& options, const uint32_t width, const uint32_t height) {
+    if (options.sizes.empty()) return {width, height};
+    if (options.sizes.size() > 1) throw std::runtime_error("Several output sizes need one output per size");
+    return resolveTarget(options.sizes.front(), width, height);
+}
+
+std::vector<uint8_t> convertToBitData(const uint8_t* pixels, const uint32_t width, const uint32_t height, const int channels,
+                                      const ConvertOptions& options, ConvertStats* stats) {
+    const ResizeTarget size = outputSize(options, width, height);
+    if (size.width != width || size.height != height) {
+        ConvertOptions unresized = options;
+        unresized.sizes.clear();
+        if (isErrorDiffusion(options.dither) || options.threshold == AUTO_THRESHOLD) {
+            const auto resized = resizeGray(pixels, width, height, size.width, size.height, options.resize_filter, channels, options.background);
+            return convertToBitData(resized.data(), size.width, size.height, 1, unresized, stats);
+        }
 
-    const std::vector<uint8_t> bitData = convertToBitData(pixels, width, height);
+        // Each resampled row is packed while it is still in cache.
+        const RowDither dither(size.width, options.dither, options.threshold);
+        const size_t bytes_per_row = (size.width + 7) / 8;
+        std::vector<uint8_t> bits(bytes_per_row * size.height);
+        resizeRows(pixels, width, height, size.width, size.height, options.resize_filter,
+                   [&](const uint32_t y, const uint8_t* row) { dither.pack(row, y, &bits[y * bytes_per_row]); }, channels, options.background);
+        if (stats && options.dither == DitherMode::None) stats->threshold = options.threshold;
+        applyFlipBudget(bits, size.width, size.height, options, stats);
+        return bits;
+    }
+
+    std::vector<uint8_t> bits;
+    if (options.dither != DitherMode::None) {
+        const auto gray = channels == 1 ? std::vector<uint8_t>() : convertToLuma(pixels, width, height, channels, options.background);
+        bits = ditherToBitData(channels == 1 ? pixels : gray.data(), width, height, options.dither);
+    } else {
+        int threshold = options.threshold;
+        if (threshold == AUTO_THRESHOLD) threshold = otsuThreshold(lumaHistogram(pixels, width, height, channels, options.background));
+        if (stats) stats->threshold = threshold;
+        bits = convertToBitData(pixels, width, height, channels, options.background, threshold);
+    }
+    applyFlipBudget(bits, width, height, options, stats);
+    return bits;
+}
+
+std::vector<uint8_t> encodePackedBMX(const std::vector<uint8_t>& bitData, const uint32_t width, const uint32_t height) {
     const std::vector<uint8_t> compressedData = compressHeatshrink(bitData.data(), bitData.size());
-    const bool should_compress = compressedData.size() < bitData.size();
+    const bool should_compress = storesCompressed(compressedData.size(), bitData.size());
+
+    std::vector<uint8_t> file;
 
     if (should_compress) {
         CompressedBmxHeader header{};
@@ -267,32 +385,177 @@ bool writeBmx(const std::string& path, const uint8_t* pixels, const uint32_t wid
         header._pad = 0;
         header.compressed_size = static_cast<uint16_t>(compressedData.size());
 
-        f.write(reinterpret_cast<const char*>(&header), sizeof(header));
-        f.write(reinterpret_cast<const char*>(compressedData.data()), compressedData.size());
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&header);
+        file.assign(bytes, bytes + sizeof(header));
+        file.insert(file.end(), compressedData.begin(), compressedData.end());
     } else {
         UncompressedBmxHeader header{};
         header.width = width;
         header.height = height;
         header.is_compressed = false;
 
-        f.write(reinterpret_cast<const char*>(&header), sizeof(header));
-        f.write(reinterpret_cast<const char*>(bitData.data()), bitData.size());
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&header);
+        file.assign(bytes, bytes + sizeof(header));
+        file.insert(file.end(), bitData.begin(), bitData.end());
     }
 
-    return true;
+    return file;
+}
+
+std::vector<uint8_t> encodeBMX(const uint8_t* pixels, const uint32_t width, const uint32_t height) {
+    return encodePackedBMX(convertToBitData(pixels, width, height), width, height);
+}
+
+std::vector<uint8_t> encodeBMX(const uint8_t* pixels, const uint32_t width, const uint32_t height, const ConvertOptions& options,
+                               ConvertStats* stats) {
+    const ResizeTarget size = outputSize(options, width, height);
+    return encodePackedBMX(convertToBitData(pixels, width, height, 1, options, stats), size.width, size.height);
+}
+
+bool writeFile(const std::string& path, const std::vector<uint8_t>& data) {
+    TraceScope trace("write");
+    std::ofstream f(path, std::ios::binary);
+    if (!f) return false;
+
+    f.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(f);
+}
+
+bool writeBmx(const std::string& path, const uint8_t* pixels, const uint32_t width, const uint32_t height, const ConvertOptions& options,
+              ConvertStats* stats) {
+    return writeFile(path, encodeBMX(pixels, width, height, options, stats));
 }
 
-bool convertImageToBM(const std::string& inputPath, const std::string& outputPath) {
-    int width, height, channels;
-    stbi_uc* pixels = stbi_load(inputPath.c_str(), &width, &height, &channels, 1);
-    if (!pixels) {
+bool writeBM(const std::string& path, const uint8_t* pixels, const uint32_t width, const uint32_t height, const ConvertOptions& options) {
+    return writeFile(path, encodeBM(convertToBitData(pixels, width, height, 1, options)));
+}
+
+namespace {
+    // Decodes with the file's own channel count (alpha included) rather than
+    // letting stb reduce to gray, which would drop alpha.
+    template <typename Convert>
+    std::vector<uint8_t> withNativeChannels(const std::vector<uint8_t>& image, uint32_t& width, uint32_t& height, Convert convert) {
+        int w, h, channels;
+        stbi_uc* pixels;
+        {
+            TraceScope trace("image decode");
+            pixels = stbi_load_from_memory(image.data(), static_cast<int>(image.size()), &w, &h, &channels, 0);
+        }
+        if (!pixels) throw std::runtime_error(std::string("Failed to load image: ") + stbi_failure_reason());
+
+        width = static_cast<uint32_t>(w);
+        height = static_cast<uint32_t>(h);
+        try {
+            auto result = convert(pixels, channels);
+            stbi_image_free(pixels);
+            return result;
+        } catch (...) {
+            stbi_image_free(pixels);
+            throw;
+        }
+    }
+}
+
+std::vector<uint8_t> decodeImage(const std::vector<uint8_t>& image, uint32_t& width, uint32_t& height, const uint8_t background) {
+    return withNativeChannels(image, width, height, [&](const uint8_t* pixels, const int channels) {
+        return convertToLuma(pixels, width, height, channels, background);
+    });
+}
+
+std::vector<uint8_t> decodeImageBits(const std::vector<uint8_t>& image, uint32_t& width, uint32_t& height, const ConvertOptions& options,
+                                     ConvertStats* stats) {
+    // Dithering and resizing need the gray levels (a two-color palette or
+    // composited transparency may be mid-gray), so only plain thresholding
+    // can take the 1-bit shortcut.
+    std::vector<uint8_t> bits;
+    int threshold = options.threshold;
+    if (options.dither == DitherMode::None && options.sizes.empty() &&
+        decodePackedPNG(image, bits, width, height, options.background, threshold, &threshold)) {
+        if (stats) stats->threshold = threshold;
+        applyFlipBudget(bits, width, height, options, stats);
+        return bits;
+    }
+
+    return withNativeChannels(image, width, height, [&](const uint8_t* pixels, const int channels) {
+        auto converted = convertToBitData(pixels, width, height, channels, options, stats);
+        const ResizeTarget size = outputSize(options, width, height);
+        width = size.width;
+        height = size.height;
+        return converted;
+    });
+}
+
+std::vector<uint8_t> convertImageToBMX(const std::vector<uint8_t>& image, const ConvertOptions& options, ConvertStats* stats) {
+    uint32_t width, height;
+    const auto bits = decodeImageBits(image, width, height, options, stats);
+    return encodePackedBMX(bits, width, height);
+}
+
+bool convertImageToBM(const std::string& inputPath, const std::string& outputPath, const ConvertOptions& options, ConvertStats* stats) {
+    const auto image = readFile(inputPath);
+
+    std::vector<uint8_t> file;
+    try {
+        file = convertImageToBMX(image, options, stats);
+    } catch (const std::runtime_error&) {
         std::cerr << "Failed to load image: " << inputPath << "\n";
         return false;
     }
+    return writeFile(outputPath, file);
+}
 
-    const bool ok = writeBmx(outputPath, pixels, width, height);
+std::vector<std::vector<uint8_t>> convertImageToBMXAtSizes(const std::vector<uint8_t>& image, const ConvertOptions& options,
+                                                           std::vector<ConvertStats>* stats) {
+    if (stats) stats->assign(options.sizes.size(), ConvertStats{});
+    uint32_t width, height;
+    std::vector<std::vector<uint8_t>> files;
+    withNativeChannels(image, width, height, [&](const uint8_t* pixels, const int channels) {
+        // Composite once; every size starts from the same gray image.
+        const auto gray = channels == 1 ? std::vector<uint8_t>() : convertToLuma(pixels, width, height, channels, options.background);
+        ConvertOptions single = options;
+        for (size_t i = 0; i < options.sizes.size(); ++i) {
+            single.sizes = {options.sizes[i]};
+            const ResizeTarget size = outputSize(single, width, height);
+            const auto bits = convertToBitData(channels == 1 ? pixels : gray.data(), width, height, 1, single, stats ? &(*stats)[i] : nullptr);
+            files.push_back(encodePackedBMX(bits, size.width, size.height));
+        }
+        return std::vector<uint8_t>();
+    });
+    return files;
+}
+
+std::vector<uint8_t> decodeGifFrames(const std::vector<uint8_t>& gif, uint32_t& width, uint32_t& height, std::vector<int>& delays_ms,
+                                     const uint8_t background) {
+    int w, h, frames, channels;
+    int* delays = nullptr;
+    stbi_uc* pixels;
+    {
+        TraceScope trace("image decode");
+        // RGBA, so pixels no frame has painted yet (alpha 0) take the background.
+        pixels = stbi_load_gif_from_memory(gif.data(), static_cast<int>(gif.size()), &delays, &w, &h, &frames, &channels, 4);
+    }
+    if (!pixels) throw std::runtime_error(std::string("Failed to load GIF: ") + stbi_failure_reason());
+
+    width = static_cast<uint32_t>(w);
+    height = static_cast<uint32_t>(h);
+    if (delays) delays_ms.assign(delays, delays + frames);
+    else delays_ms.assign(frames, 0);
+    std::vector<uint8_t> result = convertToLuma(pixels, width, height * static_cast<uint32_t>(frames), 4, background);
+    stbi_image_free(delays);
     stbi_image_free(pixels);
-    return ok;
+    return result;
+}
+
+std::vector<uint8_t> encodePNG(const std::vector<uint8_t>& pixels, const uint32_t width, const uint32_t height) {
+    std::vector<uint8_t> png;
+    const auto append = [](void* context, void* data, const int size) {
+        auto* out = static_cast<std::vector<uint8_t>*>(context);
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        out->insert(out->end(), bytes, bytes + size);
+    };
+    if (!stbi_write_png_to_func(append, &png, static_cast<int>(width), static_cast<int>(height), 1, pixels.data(), static_cast<int>(width)))
+        throw std::runtime_error("Failed to encode PNG");
+    return png;
 }
 
 BmMeta readBmMeta(const std::string& path) {
@@ -303,3 +566,11 @@ BmMeta readBmMeta(const std::string& path) {
     std::memcpy(&meta, file.data(), sizeof(BmMeta));
     return meta;
 }
+
+bool writeBmMeta(const std::string& path, const BmMeta& meta) {
+    std::ofstream f(path, std::ios::binary);
+    if (!f) return false;
+
+    f.write(reinterpret_cast<const char*>(&meta), sizeof(meta));
+    return static_cast<bool>(f);
+}
@@ -4,6 +4,10 @@
 #include <vector>
 #include <cstdint>
 
+#include "dither.h"
+#include "luma.h"
+#include "resize.h"
+
 #pragma pack(push, 1)
 struct BmxHeader {
     uint32_t width;
@@ -48,18 +52,132 @@ inline uint16_t swap_uint16(uint16_t val) {
 constexpr uint8_t WINDOW_BITS = 8;
 constexpr uint8_t LOOKAHEAD_BITS = 4;
 
+// Parameter range accepted by heatshrink; lookahead must also be below window.
+constexpr uint8_t MIN_WINDOW_BITS = 4;
+constexpr uint8_t MAX_WINDOW_BITS = 15;
+constexpr uint8_t MIN_LOOKAHEAD_BITS = 3;
+
 std::vector<uint8_t> readFile(const std::string &path);
+bool writeFile(const std::string &path, const std::vector<uint8_t> &data);
 
-std::vector<uint8_t> decompressHeatshrink(const uint8_t* input, size_t input_size);
-std::vector<uint8_t> compressHeatshrink(const uint8_t* input, size_t input_size);
+std::vector<uint8_t> decompressHeatshrink(const uint8_t* input, size_t input_size,
+                                          uint8_t window_bits = WINDOW_BITS, uint8_t lookahead_bits = LOOKAHEAD_BITS);
+std::vector<uint8_t> compressHeatshrink(const uint8_t* input, size_t input_size,
+                                        uint8_t window_bits = WINDOW_BITS, uint8_t lookahead_bits = LOOKAHEAD_BITS);
+// The heatshrink C library for any legal pair. The two above run it for
+// every pair except WINDOW_BITS/LOOKAHEAD_BITS, which goes through
+// HeatshrinkCodec (same bytes, faster); sweep times this for all pairs alike.
+std::vector<uint8_t> decompressHeatshrinkLibrary(const uint8_t* input, size_t input_size, uint8_t window_bits, uint8_t lookahead_bits);
+std::vector<uint8_t> compressHeatshrinkLibrary(const uint8_t* input, size_t input_size, uint8_t window_bits, uint8_t lookahead_bits);
+
+// Where a .bm or BMX file keeps its image: file[offset, offset + size) is a
+// heatshrink stream when is_compressed, else the raw packed bits. Headers are
+// validated (bounds included) and parsed only here.
+struct StoredData {
+    bool is_compressed;
+    size_t offset;
+    size_t size;
+};
+StoredData locateBMData(const std::vector<uint8_t>& file);
 
+std::vector<uint8_t> decodeBM(const std::vector<uint8_t>& file);
+// Packed bits to the .bm frame layout LoadBM reads, compressed only when smaller.
+std::vector<uint8_t> encodeBM(const std::vector<uint8_t>& bitData);
+// An already compressed heatshrink stream as a .bm frame: 0x01, a reserved
+// 0x00 byte, the little-endian 16-bit stream length, then the stream.
+std::vector<uint8_t> compressedBMFrame(const uint8_t* stream, size_t size);
 std::vector<uint8_t> LoadBM(const std::string &path);
+BmxHeader readBmxHeader(const uint8_t* file, size_t file_size);
+BmxHeader readBmxHeader(const std::vector<uint8_t>& file);
+// header as readBmxHeader returned it for a file of file_size bytes.
+StoredData locateBMXData(const BmxHeader& header, size_t file_size);
+std::vector<uint8_t> decodeBMX(const uint8_t* file, size_t file_size, BmxHeader& header);
+std::vector<uint8_t> decodeBMX(const std::vector<uint8_t>& file, BmxHeader& header);
 std::vector<uint8_t> LoadBMX(const std::string &path, BmxHeader &header);
 
+std::vector<uint8_t> expandBitData(const uint8_t* bitData, size_t bitDataSize, uint32_t width, uint32_t height);
 std::vector<uint8_t> expandBitData(const std::vector<uint8_t>& bitData, uint32_t width, uint32_t height);
 std::vector<uint8_t> convertToBitData(const uint8_t* data, uint32_t width, uint32_t height);
 
-bool writeBmx(const std::string &path, const uint8_t* pixels, uint32_t width, uint32_t height);
-bool convertImageToBM(const std::string &inputPath, const std::string &outputPath);
+// ConvertOptions::threshold value that picks Otsu's threshold per image.
+constexpr int AUTO_THRESHOLD = -1;
+
+// How decoded images become 1-bit: transparency is composited over the
+// background gray, then the gray image is thresholded (gray < threshold is
+// black) or dithered. max_flips > 0 then lets optimizePixelFlips change up
+// to that many isolated pixels in busy regions to shrink the stored size.
+//
+// With sizes set, the gray image is first resampled to that size, each row
+// packed as it is produced (error diffusion and the automatic threshold need
+// the whole resized image first). More than one size is only accepted by
+// convertImageToBMXAtSizes, which decodes once for all of them.
+struct ConvertOptions {
+    uint8_t background = DEFAULT_BACKGROUND;
+    DitherMode dither = DitherMode::None;
+    int threshold = DEFAULT_THRESHOLD;
+    size_t max_flips = 0;
+    std::vector<ResizeTarget> sizes;
+    ResizeFilter resize_filter = ResizeFilter::Auto;
+};
+
+// Dimensions a width x height source converts to under options; throws when
+// options name several sizes.
+ResizeTarget outputSize(const ConvertOptions& options, uint32_t width, uint32_t height);
+
+// What a conversion decided, for callers that report it.
+struct ConvertStats {
+    int threshold = DEFAULT_THRESHOLD;
+    size_t pixels_flipped = 0;
+    size_t bytes_saved = 0;   // BMX file bytes the flips saved
+};
+
+// Pixels with 1-4 channels to packed bits as the options say, at
+// outputSize(options, width, height). An automatic threshold costs one
+// histogram pass over the pixels before packing.
+std::vector<uint8_t> convertToBitData(const uint8_t* pixels, uint32_t width, uint32_t height, int channels,
+                                      const ConvertOptions& options, ConvertStats* stats = nullptr);
+
+std::vector<uint8_t> encodeBMX(const uint8_t* pixels, uint32_t width, uint32_t height);
+std::vector<uint8_t> encodeBMX(const uint8_t* pixels, uint32_t width, uint32_t height, const ConvertOptions& options,
+                               ConvertStats* stats = nullptr);
+// Longest stream the 16-bit size field of BMX and .bm headers can describe.
+constexpr size_t MAX_COMPRESSED_SIZE = 0xFFFF;
+// Whether encodePackedBMX stores a stream of compressed_size bytes rather
+// than the raw bits: it must be smaller and fit the header's size field.
+constexpr bool storesCompressed(const size_t compressed_size, const size_t raw_size) {
+    return compressed_size < raw_size && compressed_size <= MAX_COMPRESSED_SIZE;
+}
+// Compressed only when storesCompressed says so; longer streams fall back
+// to raw bits instead of a truncated size field.
+std::vector<uint8_t> encodePackedBMX(const std::vector<uint8_t>& bitData, uint32_t width, uint32_t height);
+bool writeBmx(const std::string &path, const uint8_t* pixels, uint32_t width, uint32_t height, const ConvertOptions& options = {},
+              ConvertStats* stats = nullptr);
+// Converts and stores pixels as one encodeBM frame.
+bool writeBM(const std::string &path, const uint8_t* pixels, uint32_t width, uint32_t height, const ConvertOptions& options = {});
+// Any stb-supported image file to 8-bit grayscale pixels. Transparency is
+// composited over the background gray (white by default).
+std::vector<uint8_t> decodeImage(const std::vector<uint8_t>& image, uint32_t& width, uint32_t& height,
+                                 uint8_t background = DEFAULT_BACKGROUND);
+// Any stb-supported image file to packed bits; undithered, unresized 1-bit
+// PNGs skip the 8-bit stage. width and height receive the output size.
+std::vector<uint8_t> decodeImageBits(const std::vector<uint8_t>& image, uint32_t& width, uint32_t& height,
+                                     const ConvertOptions& options = {}, ConvertStats* stats = nullptr);
+std::vector<uint8_t> convertImageToBMX(const std::vector<uint8_t>& image, const ConvertOptions& options = {},
+                                       ConvertStats* stats = nullptr);
+bool convertImageToBM(const std::string &inputPath, const std::string &outputPath, const ConvertOptions& options = {},
+                      ConvertStats* stats = nullptr);
+// One BMX per entry of options.sizes from a single decode. stats, when given,
+// receives one entry per size.
+std::vector<std::vector<uint8_t>> convertImageToBMXAtSizes(const std::vector<uint8_t>& image, const ConvertOptions& options,
+                                                           std::vector<ConvertStats>* stats = nullptr);
+
+// Every frame of an (animated) GIF as 8-bit grayscale, frames back to back.
+// delays_ms receives the per-frame display time.
+std::vector<uint8_t> decodeGifFrames(const std::vector<uint8_t>& gif, uint32_t& width, uint32_t& height, std::vector<int>& delays_ms,
+                                     uint8_t background = DEFAULT_BACKGROUND);
+
+// 8-bit grayscale pixels to an in-memory PNG.
+std::vector<uint8_t> encodePNG(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height);
 
 BmMeta readBmMeta(const std::string &path);
+bool writeBmMeta(const std::string &path, const BmMeta &meta);
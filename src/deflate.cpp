@@ -0,0 +1,349 @@
+#include "deflate.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    constexpr size_t CHUNK_SIZE = 128 * 1024;
+    constexpr size_t WINDOW_SIZE = 32768;
+    constexpr size_t MIN_MATCH = 3;
+    constexpr size_t MAX_MATCH = 258;
+    constexpr size_t MAX_STORED_BLOCK = 65535;
+    constexpr uint32_t ADLER_BASE = 65521;
+
+    constexpr int HASH_BITS = 15;
+    constexpr uint32_t HASH_SIZE = 1u << HASH_BITS;
+
+    constexpr uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                          35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    constexpr uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    constexpr uint16_t DIST_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+                                        1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    constexpr uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    // Hash chain length and "good enough" match length per level.
+    constexpr uint16_t MAX_CHAIN[MAX_DEFLATE_LEVEL + 1] = {0, 0, 4, 8, 16, 32, 64, 128, 256, 1024};
+    constexpr uint16_t NICE_LENGTH[MAX_DEFLATE_LEVEL + 1] = {0, 0, 16, 32, 32, 64, 128, 128, 258, 258};
+    constexpr int LAZY_LEVEL = 6;
+
+    constexpr uint32_t reverseBits(uint32_t code, int bits) {
+        uint32_t result = 0;
+        while (bits--) {
+            result = (result << 1) | (code & 1);
+            code >>= 1;
+        }
+        return result;
+    }
+
+    struct Code {
+        uint16_t bits;
+        uint8_t length;
+    };
+
+    // Fixed literal/length codes (RFC 1951 3.2.6), bit-reversed for LSB-first output.
+    constexpr std::array<Code, 288> makeLiteralCodes() {
+        std::array<Code, 288> codes{};
+        for (uint32_t n = 0; n < 288; ++n) {
+            if (n <= 143) codes[n] = {static_cast<uint16_t>(reverseBits(0x30 + n, 8)), 8};
+            else if (n <= 255) codes[n] = {static_cast<uint16_t>(reverseBits(0x190 + n - 144, 9)), 9};
+            else if (n <= 279) codes[n] = {static_cast<uint16_t>(reverseBits(n - 256, 7)), 7};
+            else codes[n] = {static_cast<uint16_t>(reverseBits(0xC0 + n - 280, 8)), 8};
+        }
+        return codes;
+    }
+    constexpr auto LITERAL_CODES = makeLiteralCodes();
+
+    constexpr std::array<uint8_t, MAX_MATCH + 1> makeLengthSymbols() {
+        std::array<uint8_t, MAX_MATCH + 1> symbols{};
+        for (size_t length = MIN_MATCH, code = 0; length <= MAX_MATCH; ++length) {
+            while (code + 1 < 29 && LENGTH_BASE[code + 1] <= length) ++code;
+            symbols[length] = static_cast<uint8_t>(code);
+        }
+        return symbols;
+    }
+    constexpr auto LENGTH_SYMBOLS = makeLengthSymbols();
+
+    uint8_t distanceSymbol(const uint32_t distance) {
+        return static_cast<uint8_t>(std::upper_bound(std::begin(DIST_BASE), std::end(DIST_BASE), distance) - std::begin(DIST_BASE) - 1);
+    }
+
+    class BitWriter {
+    public:
+        explicit BitWriter(std::vector<uint8_t>& out) : out(out) {}
+
+        void put(const uint32_t bits, const int count) {
+            buffer |= static_cast<uint64_t>(bits) << used;
+            used += count;
+            while (used >= 8) {
+                out.push_back(static_cast<uint8_t>(buffer));
+                buffer >>= 8;
+                used -= 8;
+            }
+        }
+
+        void align() {
+            if (used) put(0, 8 - used);
+        }
+
+    private:
+        std::vector<uint8_t>& out;
+        uint64_t buffer = 0;
+        int used = 0;
+    };
+
+    void putLiteral(BitWriter& bits, const uint8_t value) {
+        bits.put(LITERAL_CODES[value].bits, LITERAL_CODES[value].length);
+    }
+
+    void putMatch(BitWriter& bits, const size_t length, const uint32_t distance) {
+        const uint8_t lsym = LENGTH_SYMBOLS[length];
+        const Code& code = LITERAL_CODES[257 + lsym];
+        bits.put(code.bits, code.length);
+        if (LENGTH_EXTRA[lsym]) bits.put(static_cast<uint32_t>(length - LENGTH_BASE[lsym]), LENGTH_EXTRA[lsym]);
+
+        const uint8_t dsym = distanceSymbol(distance);
+        bits.put(reverseBits(dsym, 5), 5);
+        if (DIST_EXTRA[dsym]) bits.put(distance - DIST_BASE[dsym], DIST_EXTRA[dsym]);
+    }
+
+    uint32_t hash3(const uint8_t* p) {
+        return ((static_cast<uint32_t>(p[0]) << 16 | static_cast<uint32_t>(p[1]) << 8 | p[2]) * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    size_t matchLength(const uint8_t* a, const uint8_t* b, const size_t limit) {
+        size_t n = 0;
+        while (n < limit && a[n] == b[n]) ++n;
+        return n;
+    }
+
+    // LZ77 over [begin, end) with hash chains seeded from the window before
+    // begin. Positions are relative to window_start.
+    class MatchFinder {
+    public:
+        MatchFinder(const uint8_t* data, const size_t size, const size_t window_start, const size_t end, const int level)
+            : data(data), size(size), window_start(window_start), end(end),
+              max_chain(MAX_CHAIN[level]), nice_length(NICE_LENGTH[level]),
+              head(HASH_SIZE, -1), previous(end - window_start, -1) {}
+
+        void insert(const size_t pos) {
+            if (pos + MIN_MATCH > size) return;
+            const uint32_t h = hash3(data + pos);
+            previous[pos - window_start] = head[h];
+            head[h] = static_cast<int32_t>(pos - window_start);
+        }
+
+        // Longest match for pos; length 0 when there is none of MIN_MATCH bytes.
+        size_t find(const size_t pos, uint32_t& distance) const {
+            if (pos + MIN_MATCH > size) return 0;
+            const size_t limit = std::min(MAX_MATCH, end - pos);
+            if (limit < MIN_MATCH) return 0;
+
+            size_t best = MIN_MATCH - 1;
+            int32_t candidate = head[hash3(data + pos)];
+            for (uint32_t chain = max_chain; candidate >= 0 && chain > 0; --chain) {
+                const size_t from = window_start + static_cast<size_t>(candidate);
+                if (pos - from > WINDOW_SIZE) break;
+                if (data[from + best] == data[pos + best]) {
+                    const size_t length = matchLength(data + from, data + pos, limit);
+                    if (length > best) {
+                        best = length;
+                        distance = static_cast<uint32_t>(pos - from);
+                        // At limit no candidate can do better, and probing
+                        // data[pos + best] would read past the end.
+                        if (length >= nice_length || length == limit) break;
+                    }
+                }
+                candidate = previous[from - window_start];
+            }
+            return best >= MIN_MATCH ? best : 0;
+        }
+
+    private:
+        const uint8_t* data;
+        size_t size;
+        size_t window_start;
+        size_t end;
+        uint32_t max_chain;
+        size_t nice_length;
+        std::vector<int32_t> head;
+        std::vector<int32_t> previous;
+    };
+
+    void compressLz77(BitWriter& bits, const uint8_t* data, const size_t size, const size_t begin, const size_t end, const int level) {
+        const size_t window_start = begin > WINDOW_SIZE ? begin - WINDOW_SIZE : 0;
+        MatchFinder finder(data, size, window_start, end, level);
+        for (size_t pos = window_start; pos < begin; ++pos) finder.insert(pos);
+
+        size_t pos = begin;
+        while (pos < end) {
+            uint32_t distance = 0;
+            size_t length = finder.find(pos, distance);
+            finder.insert(pos);
+
+            // Lazy matching: prefer a literal if the next position matches longer.
+            if (length && level >= LAZY_LEVEL && length < NICE_LENGTH[level] && pos + 1 < end) {
+                uint32_t next_distance = 0;
+                if (finder.find(pos + 1, next_distance) > length) length = 0;
+            }
+
+            if (!length) {
+                putLiteral(bits, data[pos]);
+                ++pos;
+                continue;
+            }
+            putMatch(bits, length, distance);
+            for (size_t i = 1; i < length; ++i) finder.insert(pos + i);
+            pos += length;
+        }
+    }
+
+    void compressRuns(BitWriter& bits, const uint8_t* data, const size_t begin, const size_t end) {
+        size_t pos = begin;
+        while (pos < end) {
+            size_t run = 0;
+            if (pos > 0) run = matchLength(data + pos - 1, data + pos, std::min(MAX_MATCH, end - pos));
+            if (run >= MIN_MATCH) {
+                putMatch(bits, run, 1);
+                pos += run;
+            } else {
+                putLiteral(bits, data[pos]);
+                ++pos;
+            }
+        }
+    }
+
+    void putStored(std::vector<uint8_t>& out, const uint8_t* data, const size_t size) {
+        for (size_t pos = 0; pos < size;) {
+            const size_t block = std::min(MAX_STORED_BLOCK, size - pos);
+            out.push_back(0x00); // BFINAL = 0, BTYPE = 00, padded to the byte
+            out.push_back(static_cast<uint8_t>(block));
+            out.push_back(static_cast<uint8_t>(block >> 8));
+            out.push_back(static_cast<uint8_t>(~block));
+            out.push_back(static_cast<uint8_t>(~block >> 8));
+            out.insert(out.end(), data + pos, data + pos + block);
+            pos += block;
+        }
+    }
+
+    // Non-final deflate blocks for [begin, end), ending on a byte boundary.
+    std::vector<uint8_t> compressChunk(const uint8_t* data, const size_t size, const size_t begin, const size_t end, const int level) {
+        std::vector<uint8_t> out;
+        if (level > 0) {
+            BitWriter bits(out);
+            bits.put(0b010, 3); // BFINAL = 0, BTYPE = 01 (fixed Huffman)
+            if (level == 1) compressRuns(bits, data, begin, end);
+            else compressLz77(bits, data, size, begin, end, level);
+            bits.put(LITERAL_CODES[256].bits, LITERAL_CODES[256].length);
+            // Sync flush: an empty stored block brings the stream to a byte boundary.
+            bits.put(0b000, 3);
+            bits.align();
+            out.insert(out.end(), {0x00, 0x00, 0xFF, 0xFF});
+        }
+        // Incompressible chunks (and level 0) are stored as is.
+        const size_t stored_size = end - begin + 5 * ((end - begin + MAX_STORED_BLOCK - 1) / MAX_STORED_BLOCK);
+        if (level == 0 || out.size() > stored_size) {
+            out.clear();
+            putStored(out, data + begin, end - begin);
+        }
+        return out;
+    }
+
+    uint32_t adler32(const uint8_t* data, size_t size) {
+        uint32_t a = 1, b = 0;
+        while (size > 0) {
+            const size_t block = std::min<size_t>(size, 5552);
+            for (size_t i = 0; i < block; ++i) {
+                a += data[i];
+                b += a;
+            }
+            a %= ADLER_BASE;
+            b %= ADLER_BASE;
+            data += block;
+            size -= block;
+        }
+        return b << 16 | a;
+    }
+
+    // Checksum of A+B from the checksums of A and B (as zlib's adler32_combine).
+    uint32_t adler32Combine(const uint32_t first, const uint32_t second, const size_t second_size) {
+        const uint32_t rem = static_cast<uint32_t>(second_size % ADLER_BASE);
+        uint32_t a = first & 0xFFFF;
+        uint32_t b = static_cast<uint32_t>((static_cast<uint64_t>(rem) * a) % ADLER_BASE);
+        a += (second & 0xFFFF) + ADLER_BASE - 1;
+        b += (first >> 16) + (second >> 16) + ADLER_BASE - rem;
+        if (a >= ADLER_BASE) a -= ADLER_BASE;
+        if (a >= ADLER_BASE) a -= ADLER_BASE;
+        if (b >= 2 * ADLER_BASE) b -= 2 * ADLER_BASE;
+        if (b >= ADLER_BASE) b -= ADLER_BASE;
+        return b << 16 | a;
+    }
+
+    ThreadPool& deflatePool() {
+        // Separate from any caller's pool, so PNG writes issued from pool
+        // workers can wait on their chunks without deadlocking.
+        static ThreadPool pool;
+        return pool;
+    }
+}
+
+std::vector<uint8_t> zlibCompress(const uint8_t* data, const size_t size, int level) {
+    TraceScope trace("deflate");
+    level = std::clamp(level, 0, MAX_DEFLATE_LEVEL);
+
+    const size_t chunk_count = std::max<size_t>(1, (size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    std::vector<std::vector<uint8_t>> chunks(chunk_count);
+    std::vector<uint32_t> checksums(chunk_count);
+    const auto compress = [&](const size_t i) {
+        const size_t begin = i * CHUNK_SIZE;
+        const size_t end = std::min(size, begin + CHUNK_SIZE);
+        chunks[i] = compressChunk(data, size, begin, end, level);
+        checksums[i] = adler32(data + begin, end - begin);
+    };
+    if (chunk_count > 1) parallelFor(deflatePool(), chunk_count, compress);
+    else compress(0);
+
+    // zlib header: 32K window, FLEVEL from the level, FCHECK making it a multiple of 31.
+    const uint8_t flevel = level <= 1 ? 0 : level <= 5 ? 1 : level == 6 ? 2 : 3;
+    const uint8_t cmf = 0x78;
+    uint8_t flg = static_cast<uint8_t>(flevel << 6);
+    flg = static_cast<uint8_t>(flg + 31 - (cmf * 256 + flg) % 31);
+
+    size_t total = 2 + 2 + 4;
+    for (const auto& chunk : chunks) total += chunk.size();
+    std::vector<uint8_t> out;
+    out.reserve(total);
+    out.push_back(cmf);
+    out.push_back(flg);
+
+    uint32_t checksum = checksums[0];
+    for (size_t i = 0; i < chunk_count; ++i) {
+        out.insert(out.end(), chunks[i].begin(), chunks[i].end());
+        if (i > 0) checksum = adler32Combine(checksum, checksums[i], std::min(size, (i + 1) * CHUNK_SIZE) - i * CHUNK_SIZE);
+    }
+    // Final empty fixed-Huffman block: BFINAL = 1, BTYPE = 01, end-of-block.
+    out.push_back(0x03);
+    out.push_back(0x00);
+
+    out.push_back(static_cast<uint8_t>(checksum >> 24));
+    out.push_back(static_cast<uint8_t>(checksum >> 16));
+    out.push_back(static_cast<uint8_t>(checksum >> 8));
+    out.push_back(static_cast<uint8_t>(checksum));
+    return out;
+}
+
+unsigned char* zlibCompressForStb(unsigned char* data, const int data_len, int* out_len, const int quality) {
+    try {
+        const auto compressed = zlibCompress(data, static_cast<size_t>(data_len), quality);
+        auto* result = static_cast<unsigned char*>(std::malloc(compressed.size()));
+        if (!result) return nullptr;
+        std::memcpy(result, compressed.data(), compressed.size());
+        *out_len = static_cast<int>(compressed.size());
+        return result;
+    } catch (...) {
+        return nullptr; // stb reports a failed write
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// zlib-format compressor for PNG output. It replaces stb_image_write's
+// built-in compressor through STBIW_ZLIB_COMPRESS and is also used directly
+// by png_writer.
+//
+// Levels: 0 stores the data, 1 only encodes byte runs (distance-1 matches),
+// a quick mode for previews; 2..9 run LZ77 with longer hash chains as the
+// level rises and lazy matching from 6 up. Blocks use the fixed Huffman codes,
+// as stb's compressor does.
+//
+// Inputs of several chunks are compressed pigz-style: each 128 KiB chunk is
+// encoded on its own thread, may still reference the 32 KiB before it, and
+// ends with a sync flush so the pieces concatenate into one stream.
+constexpr int MAX_DEFLATE_LEVEL = 9;
+
+std::vector<uint8_t> zlibCompress(const uint8_t* data, size_t size, int level);
+
+// STBIW_ZLIB_COMPRESS signature; the result is malloc'd for STBIW_FREE.
+unsigned char* zlibCompressForStb(unsigned char* data, int data_len, int* out_len, int quality);
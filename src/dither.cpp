@@ -0,0 +1,330 @@
+#include "dither.h"
+#include "luma.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    struct ThresholdMatrix {
+        uint32_t size;
+        std::vector<uint8_t> values; // size * size thresholds in 1..255; black if gray < value
+    };
+
+    // Rank r of n cells maps to the middle of its band of the open range
+    // 1..255, rounded up: gray g is then black in (255 - g) / 254 of the
+    // cells, so 0 stays solid black, 255 solid white and 127.5 is half.
+    uint8_t rankThreshold(const uint32_t rank, const uint32_t cells) {
+        return static_cast<uint8_t>(1 + ((2 * rank + 1) * 127 + cells - 1) / cells);
+    }
+
+    // Recursive Bayer construction: each cell of the n/2 matrix expands into
+    // the 2x2 pattern 0 2 / 3 1, scaled by 4.
+    ThresholdMatrix makeBayer(const uint32_t size) {
+        std::vector<uint32_t> rank{0};
+        for (uint32_t n = 1; n < size; n *= 2) {
+            std::vector<uint32_t> next(4 * n * n);
+            for (uint32_t y = 0; y < n; ++y) {
+                for (uint32_t x = 0; x < n; ++x) {
+                    const uint32_t r = 4 * rank[y * n + x];
+                    next[y * 2 * n + x] = r;
+                    next[y * 2 * n + x + n] = r + 2;
+                    next[(y + n) * 2 * n + x] = r + 3;
+                    next[(y + n) * 2 * n + x + n] = r + 1;
+                }
+            }
+            rank = std::move(next);
+        }
+        ThresholdMatrix matrix{size, std::vector<uint8_t>(rank.size())};
+        for (size_t i = 0; i < rank.size(); ++i) matrix.values[i] = rankThreshold(rank[i], static_cast<uint32_t>(rank.size()));
+        return matrix;
+    }
+
+    // Ulichney's void-and-cluster method on a torus. Energy is a Gaussian-
+    // weighted count of set cells around each cell, kept in fixed point so
+    // the mask comes out the same everywhere.
+    class VoidAndCluster {
+    public:
+        static constexpr uint32_t SIZE = 64;
+        static constexpr uint32_t CELLS = SIZE * SIZE;
+
+        VoidAndCluster() : kernel(CELLS), energy(CELLS, 0), set(CELLS, 0) {
+            constexpr double sigma = 1.5;
+            for (uint32_t y = 0; y < SIZE; ++y) {
+                for (uint32_t x = 0; x < SIZE; ++x) {
+                    const double dx = std::min(x, SIZE - x), dy = std::min(y, SIZE - y);
+                    kernel[y * SIZE + x] = static_cast<uint32_t>(std::lround(65536.0 * std::exp(-(dx * dx + dy * dy) / (2 * sigma * sigma))));
+                }
+            }
+        }
+
+        std::vector<uint32_t> ranks() {
+            // Initial pattern: a tenth of the cells, placed by a fixed LCG.
+            uint32_t seed = 12345, ones = 0;
+            while (ones < CELLS / 10) {
+                seed = seed * 1664525u + 1013904223u;
+                const uint32_t i = (seed >> 8) % CELLS;
+                if (!set[i]) {
+                    toggle(i);
+                    ++ones;
+                }
+            }
+            // Move the tightest cluster into the largest void until that changes nothing.
+            for (;;) {
+                const uint32_t cluster = tightestCluster();
+                toggle(cluster);
+                const uint32_t gap = largestVoid();
+                toggle(gap);
+                if (gap == cluster) break;
+            }
+
+            std::vector<uint32_t> rank(CELLS);
+            const std::vector<uint8_t> prototype = set;
+            const std::vector<uint64_t> prototype_energy = energy;
+            // Ranks below the prototype's count: remove clusters one by one.
+            for (uint32_t r = ones; r-- > 0;) {
+                const uint32_t cluster = tightestCluster();
+                toggle(cluster);
+                rank[cluster] = r;
+            }
+            set = prototype;
+            energy = prototype_energy;
+            // Ranks above: fill the largest void until the pattern is full.
+            for (uint32_t r = ones; r < CELLS; ++r) {
+                const uint32_t gap = largestVoid();
+                toggle(gap);
+                rank[gap] = r;
+            }
+            return rank;
+        }
+
+    private:
+        void toggle(const uint32_t i) {
+            set[i] = !set[i];
+            const uint32_t cx = i % SIZE, cy = i / SIZE;
+            const int64_t sign = set[i] ? 1 : -1;
+            for (uint32_t y = 0; y < SIZE; ++y) {
+                // The kernel row, rotated so that column cx lines up with offset 0.
+                const uint32_t* k = &kernel[((y + SIZE - cy) % SIZE) * SIZE];
+                uint64_t* e = &energy[y * SIZE];
+                for (uint32_t x = 0; x < cx; ++x) e[x] += sign * k[SIZE - cx + x];
+                for (uint32_t x = cx; x < SIZE; ++x) e[x] += sign * k[x - cx];
+            }
+        }
+
+        uint32_t tightestCluster() const {
+            uint32_t best = CELLS;
+            for (uint32_t i = 0; i < CELLS; ++i)
+                if (set[i] && (best == CELLS || energy[i] > energy[best])) best = i;
+            return best;
+        }
+
+        uint32_t largestVoid() const {
+            uint32_t best = CELLS;
+            for (uint32_t i = 0; i < CELLS; ++i)
+                if (!set[i] && (best == CELLS || energy[i] < energy[best])) best = i;
+            return best;
+        }
+
+        std::vector<uint32_t> kernel;
+        std::vector<uint64_t> energy;
+        std::vector<uint8_t> set;
+    };
+
+    ThresholdMatrix makeBlueNoise() {
+        TraceScope trace("blue noise mask");
+        const auto rank = VoidAndCluster().ranks();
+        ThresholdMatrix matrix{VoidAndCluster::SIZE, std::vector<uint8_t>(rank.size())};
+        for (size_t i = 0; i < rank.size(); ++i) matrix.values[i] = rankThreshold(rank[i], VoidAndCluster::CELLS);
+        return matrix;
+    }
+
+    // Error-diffusion weights, out of 1 << shift. The same-row weights are
+    // carried in registers; the rest go to per-row error accumulators.
+    struct DiffusionKernel {
+        int shift;
+        int32_t right1, right2;  // (x + 1, y), (x + 2, y)
+        int32_t below[3];        // (x - 1, y + 1), (x, y + 1), (x + 1, y + 1)
+        int32_t below2;          // (x, y + 2)
+    };
+    constexpr DiffusionKernel FLOYD_STEINBERG{4, 7, 0, {3, 5, 1}, 0};
+    constexpr DiffusionKernel ATKINSON{3, 1, 1, {1, 1, 1}, 1};
+
+    // Pixels a row processes between progress updates, and the image size
+    // below which the threads cost more than they save.
+    constexpr uint32_t WAVEFRONT_BLOCK = 64;
+    constexpr size_t PARALLEL_MIN_PIXELS = 256 * 256;
+
+    ThreadPool& ditherPool() {
+        // Separate from any caller's pool, like deflate's: conversions running
+        // on pool workers can then dither without waiting on themselves.
+        static ThreadPool pool;
+        return pool;
+    }
+
+    std::vector<uint8_t> diffuse(const uint8_t* pixels, const uint32_t width, const uint32_t height, const DiffusionKernel& kernel) {
+        TraceScope trace("dither");
+        const size_t bytes_per_row = (width + 7) / 8;
+        std::vector<uint8_t> bitData(bytes_per_row * height, 0);
+
+        // Rows are claimed in order by whichever thread is free, the caller
+        // included, so every claimed row has a running owner and the chain
+        // of waits always moves even when pool threads start late or not at
+        // all. At most `participants` rows are unfinished at once, and rows
+        // finish in order, so error rows live in a ring a few slots larger.
+        ThreadPool& pool = ditherPool();
+        const bool parallel = height > 1 && static_cast<size_t>(width) * height >= PARALLEL_MIN_PIXELS;
+        const size_t participants = parallel ? pool.size() + 1 : 1;
+        const int reach = kernel.below2 ? 2 : 1;
+        const size_t ring = participants + 3;
+        const size_t stride = width + 2; // a pad column either side for the x - 1 / x + 1 taps
+        std::vector<int32_t> errors(ring * stride, 0);
+        std::vector<std::atomic<uint32_t>> progress(height); // pixels finished per row
+        std::atomic<uint32_t> next_row{0};
+
+        const auto run = [&] {
+            for (uint32_t y; (y = next_row.fetch_add(1)) < height;) {
+                int32_t* error = &errors[(y % ring) * stride + 1];
+                int32_t* below = &errors[((y + 1) % ring) * stride + 1];
+                int32_t* below2 = &errors[((y + 2) % ring) * stride + 1];
+                // Nothing has written row y + reach yet, and its slot's last
+                // user finished long ago.
+                std::fill_n(&errors[((y + reach) % ring) * stride], stride, 0);
+
+                const uint8_t* row = pixels + static_cast<size_t>(y) * width;
+                uint8_t* bits = &bitData[y * bytes_per_row];
+                const int32_t half = 1 << (kernel.shift - 1);
+                int32_t carry1 = 0, carry2 = 0;
+                for (uint32_t x0 = 0; x0 < width; x0 += WAVEFRONT_BLOCK) {
+                    const uint32_t x1 = std::min(width, x0 + WAVEFRONT_BLOCK);
+                    // Pixel x takes error from x + 1 of the row above.
+                    if (y > 0) {
+                        const uint32_t needed = std::min(width, x1 + 1);
+                        for (uint32_t seen; (seen = progress[y - 1].load(std::memory_order_acquire)) < needed;)
+                            progress[y - 1].wait(seen, std::memory_order_acquire);
+                    }
+                    for (uint32_t x = x0; x < x1; ++x) {
+                        const int32_t value = row[x] + ((error[x] + carry1 + half) >> kernel.shift);
+                        const bool black = value < 128;
+                        const int32_t e = value - (black ? 0 : 255);
+                        carry1 = carry2 + e * kernel.right1;
+                        carry2 = e * kernel.right2;
+                        int32_t* under = below + x; // x is unsigned; index the pad column through a pointer
+                        under[-1] += e * kernel.below[0];
+                        under[0] += e * kernel.below[1];
+                        under[1] += e * kernel.below[2];
+                        if (kernel.below2) below2[x] += e * kernel.below2;
+                        bits[x / 8] |= static_cast<uint8_t>(black) << (x % 8);
+                    }
+                    progress[y].store(x1, std::memory_order_release);
+                    progress[y].notify_all();
+                }
+            }
+        };
+
+        std::vector<std::future<void>> helpers;
+        for (size_t i = 1; i < participants; ++i) helpers.push_back(pool.submit(run));
+        run();
+        for (auto& helper : helpers) helper.get();
+        return bitData;
+    }
+
+    const ThresholdMatrix& thresholdMatrix(const DitherMode mode) {
+        static const ThresholdMatrix bayer2 = makeBayer(2), bayer4 = makeBayer(4), bayer8 = makeBayer(8);
+        switch (mode) {
+            case DitherMode::Bayer2: return bayer2;
+            case DitherMode::Bayer4: return bayer4;
+            case DitherMode::Bayer8: return bayer8;
+            case DitherMode::BlueNoise: {
+                static const ThresholdMatrix blue_noise = makeBlueNoise(); // ~50 ms, built on first use
+                return blue_noise;
+            }
+            default: throw std::logic_error("No threshold matrix for this dither mode");
+        }
+    }
+
+    // One row against a threshold row of the same width. Whole bytes take a
+    // fixed 8-pixel body the compiler turns into vector compares.
+    void packRow(const uint8_t* row, const uint8_t* thresholds, const uint32_t width, uint8_t* bits) {
+        const size_t full_bytes = width / 8;
+        for (size_t b = 0; b < full_bytes; ++b) {
+            uint8_t byte = 0;
+            for (int k = 0; k < 8; ++k) byte |= static_cast<uint8_t>(row[8 * b + k] < thresholds[8 * b + k]) << k;
+            bits[b] = byte;
+        }
+        if (full_bytes * 8 < width) {
+            uint8_t byte = 0;
+            for (uint32_t x = static_cast<uint32_t>(full_bytes * 8); x < width; ++x) byte |= static_cast<uint8_t>(row[x] < thresholds[x]) << (x % 8);
+            bits[full_bytes] = byte;
+        }
+    }
+}
+
+DitherMode parseDitherMode(const std::string& name) {
+    for (const DitherMode mode : {DitherMode::None, DitherMode::Bayer2, DitherMode::Bayer4, DitherMode::Bayer8, DitherMode::BlueNoise,
+                                  DitherMode::FloydSteinberg, DitherMode::Atkinson}) {
+        if (name == ditherModeName(mode)) return mode;
+    }
+    throw std::runtime_error("Unknown dither mode: " + name);
+}
+
+const char* ditherModeName(const DitherMode mode) {
+    switch (mode) {
+        case DitherMode::None: return "none";
+        case DitherMode::Bayer2: return "bayer2";
+        case DitherMode::Bayer4: return "bayer4";
+        case DitherMode::Bayer8: return "bayer8";
+        case DitherMode::BlueNoise: return "bluenoise";
+        case DitherMode::FloydSteinberg: return "floyd-steinberg";
+        case DitherMode::Atkinson: return "atkinson";
+    }
+    return "unknown";
+}
+
+std::vector<uint8_t> ditherToBitData(const uint8_t* pixels, const uint32_t width, const uint32_t height, const DitherMode mode) {
+    if (mode == DitherMode::None) return convertToBitData(pixels, width, height, 1);
+    if (mode == DitherMode::FloydSteinberg) return diffuse(pixels, width, height, FLOYD_STEINBERG);
+    if (mode == DitherMode::Atkinson) return diffuse(pixels, width, height, ATKINSON);
+
+    const RowDither dither(width, mode);
+    TraceScope trace("dither");
+    const size_t bytes_per_row = (width + 7) / 8;
+    std::vector<uint8_t> bitData(bytes_per_row * height);
+    for (uint32_t y = 0; y < height; ++y) dither.pack(pixels + static_cast<size_t>(y) * width, y, &bitData[y * bytes_per_row]);
+    return bitData;
+}
+
+bool isErrorDiffusion(const DitherMode mode) {
+    return mode == DitherMode::FloydSteinberg || mode == DitherMode::Atkinson;
+}
+
+RowDither::RowDither(const uint32_t width, const DitherMode mode, const int threshold) : width(width), period(1) {
+    if (isErrorDiffusion(mode)) throw std::logic_error("Error diffusion cannot run row by row");
+    if (mode == DitherMode::None) {
+        all_black = threshold >= 256;
+        rows.assign(width, static_cast<uint8_t>(std::clamp(threshold, 0, 255)));
+        return;
+    }
+    // The matrix rows, tiled out to the image width once, so the per-pixel
+    // work is the same compare as the plain threshold.
+    const ThresholdMatrix& matrix = thresholdMatrix(mode);
+    period = matrix.size;
+    rows.resize(static_cast<size_t>(period) * width);
+    for (uint32_t y = 0; y < period; ++y) {
+        for (uint32_t x = 0; x < width; ++x) rows[static_cast<size_t>(y) * width + x] = matrix.values[y * matrix.size + x % matrix.size];
+    }
+}
+
+void RowDither::pack(const uint8_t* row, const uint32_t y, uint8_t* bits) const {
+    if (all_black) {
+        // Padding bits past width stay clear, as packRow leaves them.
+        std::fill(bits, bits + width / 8, uint8_t{0xFF});
+        if (width % 8) bits[width / 8] = static_cast<uint8_t>((1u << (width % 8)) - 1);
+        return;
+    }
+    packRow(row, &rows[static_cast<size_t>(y % period) * width], width, bits);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "luma.h"
+
+// How an 8-bit gray image becomes 1-bit. None is the plain gray < 128
+// threshold; the ordered modes compare each pixel against a tiled threshold
+// matrix instead, which turns gradients into patterns rather than blobs.
+// The error-diffusion modes push each pixel's rounding error onto the
+// pixels right of and below it; they look best but depend on every earlier
+// pixel, so rows run as a wavefront across threads (see ditherToBitData).
+enum class DitherMode {
+    None,
+    Bayer2,
+    Bayer4,
+    Bayer8,
+    BlueNoise, // 64x64 void-and-cluster mask, tileable
+    FloydSteinberg,
+    Atkinson,  // diffuses 6/8 of the error, keeping more contrast
+};
+
+// "none", "bayer2", "bayer4", "bayer8", "bluenoise", "floyd-steinberg" or
+// "atkinson"; throws on anything else.
+DitherMode parseDitherMode(const std::string& name);
+const char* ditherModeName(DitherMode mode);
+
+// 8-bit gray pixels to packed bits (LSB-first, set bit = black).
+//
+// Error diffusion runs one row per thread, each row trailing the one above
+// by a couple of pixels. Arithmetic is integer-only, so the bits match a
+// single-threaded run exactly whatever the thread count or timing.
+std::vector<uint8_t> ditherToBitData(const uint8_t* pixels, uint32_t width, uint32_t height, DitherMode mode);
+
+bool isErrorDiffusion(DitherMode mode);
+
+// The plain threshold or an ordered mode applied one row at a time, for
+// producers that emit rows on the fly (the resampler). Error diffusion needs
+// the whole image and is rejected. threshold applies to None, 0-256 like
+// convertToBitData (256 makes every pixel black).
+class RowDither {
+public:
+    RowDither(uint32_t width, DitherMode mode, int threshold = DEFAULT_THRESHOLD);
+
+    // Packs gray row y into bits ((width + 7) / 8 bytes).
+    void pack(const uint8_t* row, uint32_t y, uint8_t* bits) const;
+
+private:
+    uint32_t width;
+    uint32_t period;            // rows before the threshold pattern repeats
+    std::vector<uint8_t> rows;  // period threshold rows, tiled to width
+    bool all_black = false;     // threshold 256, which no uint8_t row can hold
+};
@@ -0,0 +1,195 @@
+#include "flip_optimizer.h"
+#include "bm_utils.h"
+#include "heatshrink_codec.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <set>
+
+namespace {
+    using Codec = HeatshrinkCodec<WINDOW_BITS, LOOKAHEAD_BITS>;
+
+    // A flip at byte b changes the tokens whose lookahead covers b and the
+    // back-references the next window of bytes makes to it, so it is scored
+    // by parsing from PARSE_BEFORE bytes before b to REACH_AFTER after it
+    // (slack included for the parse to fall back into step), with the window
+    // of bytes before that as history. Flips closer together than REACH
+    // would change each other's score and are never applied in one round.
+    constexpr size_t PARSE_BEFORE = Codec::LOOKAHEAD_SIZE;
+    constexpr size_t REACH_BEFORE = Codec::WINDOW_SIZE + PARSE_BEFORE;
+    constexpr size_t REACH_AFTER = Codec::WINDOW_SIZE + 2 * Codec::LOOKAHEAD_SIZE;
+    constexpr size_t REACH = std::max(REACH_BEFORE, REACH_AFTER);
+
+    // A pixel is in a busy region when at least 16 of the 40 neighbour pairs
+    // in the 5x5 box around it differ.
+    constexpr uint32_t BUSY_RADIUS = 2;
+    constexpr int BUSY_MIN_TRANSITIONS = 16;
+
+    // Extra header bytes a compressed frame carries over a raw one (BMX: 12
+    // vs 9; .bm: 4 vs 1).
+    constexpr size_t COMPRESSED_OVERHEAD = sizeof(CompressedBmxHeader) - sizeof(UncompressedBmxHeader);
+
+    constexpr int64_t UNSCORED = std::numeric_limits<int64_t>::min();
+    // Candidates scored per pool task.
+    constexpr size_t SCORE_CHUNK = 64;
+
+    ThreadPool& flipPool() {
+        // Own pool, as for deflate and dither, so batch workers can call in.
+        static ThreadPool pool;
+        return pool;
+    }
+
+    struct Bitmap {
+        std::vector<uint8_t>& bits;
+        uint32_t width;
+        uint32_t height;
+        size_t stride;
+
+        size_t byteOf(const uint32_t x, const uint32_t y) const { return y * stride + x / 8; }
+        bool at(const uint32_t x, const uint32_t y) const { return bits[byteOf(x, y)] >> (x % 8) & 1; }
+        void flip(const uint32_t x, const uint32_t y) { bits[byteOf(x, y)] ^= static_cast<uint8_t>(1u << (x % 8)); }
+    };
+
+    bool isCandidate(const Bitmap& image, const uint32_t x, const uint32_t y) {
+        if (x == 0 || y == 0 || x + 1 >= image.width || y + 1 >= image.height) return false;
+        const bool value = image.at(x, y);
+        if (image.at(x - 1, y) == value || image.at(x + 1, y) == value || image.at(x, y - 1) == value || image.at(x, y + 1) == value)
+            return false;
+
+        const uint32_t x0 = x > BUSY_RADIUS ? x - BUSY_RADIUS : 0, x1 = std::min(image.width - 1, x + BUSY_RADIUS);
+        const uint32_t y0 = y > BUSY_RADIUS ? y - BUSY_RADIUS : 0, y1 = std::min(image.height - 1, y + BUSY_RADIUS);
+        int transitions = 0;
+        for (uint32_t by = y0; by <= y1; ++by) {
+            for (uint32_t bx = x0; bx <= x1; ++bx) {
+                if (bx < x1) transitions += image.at(bx, by) != image.at(bx + 1, by);
+                if (by < y1) transitions += image.at(bx, by) != image.at(bx, by + 1);
+            }
+        }
+        return transitions >= BUSY_MIN_TRANSITIONS;
+    }
+
+    // Local stream cost around bits[byte] with mask XORed into it.
+    int64_t localBits(const std::vector<uint8_t>& bits, const size_t byte, const uint8_t mask, std::vector<uint8_t>& segment) {
+        const size_t begin = byte > REACH_BEFORE ? byte - REACH_BEFORE : 0;
+        const size_t start = byte > PARSE_BEFORE ? byte - PARSE_BEFORE - begin : 0;
+        const size_t end = std::min(bits.size(), byte + REACH_AFTER);
+        segment.assign(bits.begin() + static_cast<std::ptrdiff_t>(begin), bits.begin() + static_cast<std::ptrdiff_t>(end));
+        segment[byte - begin] ^= mask;
+        return static_cast<int64_t>(Codec::compressedBits(segment.data(), segment.size(), start));
+    }
+}
+
+FlipResult optimizePixelFlips(std::vector<uint8_t>& bitData, const uint32_t width, const uint32_t height, const size_t max_flips) {
+    TraceScope trace("pixel flips");
+    FlipResult result;
+    result.bits_before = result.bits_after = Codec::compressedBits(bitData.data(), bitData.size());
+    if (max_flips == 0 || width < 3 || height < 3) return result;
+
+    // Bytes stored for a stream of `bits`, whichever of stream and raw bits is smaller.
+    // Streams too long for the header's size field are stored raw too.
+    const auto storedBytes = [raw = bitData.size()](const size_t bits) {
+        const size_t compressed = (bits + 7) / 8;
+        return compressed > MAX_COMPRESSED_SIZE ? raw : std::min(compressed + COMPRESSED_OVERHEAD, raw);
+    };
+    const std::vector<uint8_t> original = bitData;
+
+    Bitmap image{bitData, width, height, (static_cast<size_t>(width) + 7) / 8};
+    const size_t pixel_count = static_cast<size_t>(width) * height;
+    // Scores stay valid until a flip lands within REACH bytes of the pixel.
+    std::vector<int64_t> gain(pixel_count, UNSCORED);
+    // Flips from a round that made the whole stream longer.
+    std::vector<bool> rejected(pixel_count, false);
+
+    // Rounds: score stale candidates in parallel, apply the best
+    // non-interacting ones, keep them if the whole stream got shorter.
+    while (result.pixels_changed < max_flips) {
+        std::vector<uint32_t> candidates;
+        for (uint32_t y = 0; y < height; ++y)
+            for (uint32_t x = 0; x < width; ++x)
+                if (const size_t p = static_cast<size_t>(y) * width + x; !rejected[p] && isCandidate(image, x, y))
+                    candidates.push_back(static_cast<uint32_t>(p));
+
+        // Candidates come in row order, so those sharing a byte are adjacent
+        // and share its unflipped cost.
+        std::vector<uint32_t> stale;
+        for (const uint32_t p : candidates)
+            if (gain[p] == UNSCORED) stale.push_back(p);
+        const auto score = [&](const size_t chunk) {
+            std::vector<uint8_t> segment;
+            size_t base_byte = SIZE_MAX;
+            int64_t base = 0;
+            const size_t end = std::min(stale.size(), (chunk + 1) * SCORE_CHUNK);
+            for (size_t i = chunk * SCORE_CHUNK; i < end; ++i) {
+                const uint32_t x = stale[i] % width, y = stale[i] / width;
+                const size_t byte = image.byteOf(x, y);
+                if (byte != base_byte) {
+                    base = localBits(bitData, byte, 0, segment);
+                    base_byte = byte;
+                }
+                gain[stale[i]] = base - localBits(bitData, byte, static_cast<uint8_t>(1u << (x % 8)), segment);
+            }
+        };
+        const size_t chunk_count = (stale.size() + SCORE_CHUNK - 1) / SCORE_CHUNK;
+        if (chunk_count > 1) parallelFor(flipPool(), chunk_count, score);
+        else if (chunk_count == 1) score(0);
+
+        std::vector<uint32_t> ranked;
+        for (const uint32_t p : candidates)
+            if (gain[p] > 0) ranked.push_back(p);
+        if (ranked.empty()) break;
+        std::stable_sort(ranked.begin(), ranked.end(), [&](const uint32_t a, const uint32_t b) { return gain[a] > gain[b]; });
+
+        // Greedy pick, keeping flips REACH bytes apart and two pixels apart
+        // (rows can be further apart in bytes than REACH).
+        std::vector<uint32_t> chosen;
+        std::set<size_t> chosen_bytes;
+        std::vector<bool> blocked(pixel_count, false);
+        for (const uint32_t p : ranked) {
+            if (result.pixels_changed + chosen.size() >= max_flips) break;
+            if (blocked[p]) continue;
+            const uint32_t x = p % width, y = p / width;
+            const size_t byte = image.byteOf(x, y);
+            const auto near = chosen_bytes.lower_bound(byte >= REACH ? byte - REACH + 1 : 0);
+            if (near != chosen_bytes.end() && *near < byte + REACH) continue;
+
+            chosen.push_back(p);
+            chosen_bytes.insert(byte);
+            for (uint32_t by = y > 2 ? y - 2 : 0; by <= std::min(height - 1, y + 2); ++by)
+                for (uint32_t bx = x > 2 ? x - 2 : 0; bx <= std::min(width - 1, x + 2); ++bx)
+                    blocked[static_cast<size_t>(by) * width + bx] = true;
+        }
+
+        for (const uint32_t p : chosen) image.flip(p % width, p / width);
+        const size_t total = Codec::compressedBits(bitData.data(), bitData.size());
+        if (total >= result.bits_after) {
+            for (const uint32_t p : chosen) {
+                image.flip(p % width, p / width);
+                rejected[p] = true;
+            }
+            continue;
+        }
+        result.bits_after = total;
+        result.pixels_changed += chosen.size();
+
+        for (const size_t byte : chosen_bytes) {
+            const size_t first = byte >= REACH ? byte - REACH + 1 : 0;
+            const size_t last = std::min(bitData.size(), byte + REACH);
+            for (size_t b = first; b < last; ++b) {
+                const size_t y = b / image.stride, x0 = (b % image.stride) * 8;
+                for (size_t x = x0; x < std::min<size_t>(width, x0 + 8); ++x) gain[y * width + x] = UNSCORED;
+            }
+        }
+    }
+
+    // Rounds follow the stream so they can work their way below the raw
+    // size; flips that never get the stored size down are damage for nothing.
+    if (result.pixels_changed > 0 && storedBytes(result.bits_after) >= storedBytes(result.bits_before)) {
+        bitData = original;
+        result.pixels_changed = 0;
+        result.bits_after = result.bits_before;
+    }
+    return result;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Near-lossless rate-distortion pass for packed bits (LSB-first, set bit =
+// black) that are stored heatshrink-compressed with the 8/4 parameters.
+// Flips isolated pixels (ones that differ from all four neighbours) inside
+// busy, dithered or noisy regions when the flip lets the encoder find longer
+// back-references, changing at most max_flips pixels. Flat areas and lone
+// details on a plain background are never touched.
+//
+// Files fall back to the raw bits when the stream is not smaller, so what
+// counts is the stored size, min(stream + header overhead, raw). The flips
+// are all undone when they leave that unchanged (e.g. a noisy image whose
+// stream stays above the raw size).
+struct FlipResult {
+    size_t pixels_changed = 0;
+    size_t bits_before = 0; // compressed stream length, before byte padding
+    size_t bits_after = 0;
+};
+
+FlipResult optimizePixelFlips(std::vector<uint8_t>& bitData, uint32_t width, uint32_t height, size_t max_flips);
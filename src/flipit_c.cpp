@@ -0,0 +1,121 @@
+#include "flipit_c.h"
+
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#include "bm_utils.h"
+
+namespace {
+    size_t packedSize(const uint32_t width, const uint32_t height) {
+        return static_cast<size_t>((width + 7) / 8) * height;
+    }
+
+    flipit_status copyOut(const std::vector<uint8_t>& data, uint8_t* out, const size_t capacity, size_t* out_size) {
+        *out_size = data.size();
+        if (data.size() > capacity) return FLIPIT_ERROR_BUFFER_TOO_SMALL;
+        if (!data.empty()) std::memcpy(out, data.data(), data.size());
+        return FLIPIT_OK;
+    }
+
+    // Runs fn, translating the library's exceptions into status codes.
+    template <typename F>
+    flipit_status guarded(F&& fn) {
+        try {
+            return fn();
+        } catch (const std::bad_alloc&) {
+            return FLIPIT_ERROR_OUT_OF_MEMORY;
+        } catch (const std::runtime_error&) {
+            return FLIPIT_ERROR_CORRUPT_DATA;
+        } catch (const std::length_error&) {
+            return FLIPIT_ERROR_CORRUPT_DATA;
+        } catch (...) {
+            return FLIPIT_ERROR_INTERNAL;
+        }
+    }
+
+    void fillInfo(const BmxHeader& header, flipit_bmx_info* info) {
+        if (!info) return;
+        info->width = header.width;
+        info->height = header.height;
+        info->is_compressed = header.is_compressed ? 1 : 0;
+        info->compressed_size = header.compressed_size;
+        info->packed_size = packedSize(header.width, header.height);
+    }
+}
+
+uint32_t flipit_abi_version(void) {
+    return FLIPIT_ABI_VERSION;
+}
+
+const char* flipit_status_string(const flipit_status status) {
+    switch (status) {
+        case FLIPIT_OK: return "ok";
+        case FLIPIT_ERROR_INVALID_ARGUMENT: return "invalid argument";
+        case FLIPIT_ERROR_BUFFER_TOO_SMALL: return "output buffer too small";
+        case FLIPIT_ERROR_CORRUPT_DATA: return "corrupt or truncated data";
+        case FLIPIT_ERROR_OUT_OF_MEMORY: return "out of memory";
+        case FLIPIT_ERROR_INTERNAL: return "internal error";
+    }
+    return "unknown status";
+}
+
+flipit_status flipit_probe(const uint8_t* bmx, const size_t bmx_size, flipit_bmx_info* info) {
+    if (!bmx || !info) return FLIPIT_ERROR_INVALID_ARGUMENT;
+    return guarded([&] {
+        fillInfo(readBmxHeader(bmx, bmx_size), info);
+        return FLIPIT_OK;
+    });
+}
+
+flipit_status flipit_decode_bmx(const uint8_t* bmx, const size_t bmx_size, uint8_t* bits, const size_t bits_capacity,
+                                size_t* out_size, flipit_bmx_info* info) {
+    if (!bmx || !out_size || (!bits && bits_capacity)) return FLIPIT_ERROR_INVALID_ARGUMENT;
+    return guarded([&] {
+        BmxHeader header{};
+        const auto decoded = decodeBMX(bmx, bmx_size, header);
+        fillInfo(header, info);
+        return copyOut(decoded, bits, bits_capacity, out_size);
+    });
+}
+
+flipit_status flipit_encode_bmx(const uint8_t* pixels, const uint32_t width, const uint32_t height, uint8_t* bmx,
+                                const size_t bmx_capacity, size_t* out_size) {
+    if (!pixels || !out_size || (!bmx && bmx_capacity)) return FLIPIT_ERROR_INVALID_ARGUMENT;
+    return guarded([&] {
+        return copyOut(encodeBMX(pixels, width, height), bmx, bmx_capacity, out_size);
+    });
+}
+
+flipit_status flipit_expand_bits(const uint8_t* bits, const size_t bits_size, const uint32_t width, const uint32_t height,
+                                 uint8_t* pixels, const size_t pixels_capacity, size_t* out_size) {
+    if (!bits || !out_size || (!pixels && pixels_capacity)) return FLIPIT_ERROR_INVALID_ARGUMENT;
+    return guarded([&] {
+        return copyOut(expandBitData(bits, bits_size, width, height), pixels, pixels_capacity, out_size);
+    });
+}
+
+flipit_status flipit_pack_bits(const uint8_t* pixels, const uint32_t width, const uint32_t height, uint8_t* bits,
+                               const size_t bits_capacity, size_t* out_size) {
+    if (!pixels || !out_size || (!bits && bits_capacity)) return FLIPIT_ERROR_INVALID_ARGUMENT;
+    return guarded([&] {
+        return copyOut(convertToBitData(pixels, width, height), bits, bits_capacity, out_size);
+    });
+}
+
+flipit_status flipit_compress(const uint8_t* input, const size_t input_size, uint8_t* output, const size_t output_capacity,
+                              size_t* out_size) {
+    if ((!input && input_size) || !out_size || (!output && output_capacity)) return FLIPIT_ERROR_INVALID_ARGUMENT;
+    return guarded([&] {
+        return copyOut(compressHeatshrink(input, input_size), output, output_capacity, out_size);
+    });
+}
+
+flipit_status flipit_decompress(const uint8_t* input, const size_t input_size, uint8_t* output, const size_t output_capacity,
+                                size_t* out_size) {
+    if ((!input && input_size) || !out_size || (!output && output_capacity)) return FLIPIT_ERROR_INVALID_ARGUMENT;
+    return guarded([&] {
+        return copyOut(decompressHeatshrink(input, input_size), output, output_capacity, out_size);
+    });
+}
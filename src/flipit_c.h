@@ -0,0 +1,89 @@
+#ifndef FLIPIT_C_H
+#define FLIPIT_C_H
+
+/*
+ * Stable C interface to flipit for in-process use from other languages.
+ *
+ * All functions work on caller-owned buffers with explicit lengths and never
+ * throw. Functions that produce variable-size output take the buffer capacity
+ * and report the number of bytes written through *out_size; when the buffer is
+ * too small they return FLIPIT_ERROR_BUFFER_TOO_SMALL and set *out_size to the
+ * size required, so callers can query with a NULL buffer and capacity 0.
+ *
+ * Packed bits use the BMX layout: rows padded to whole bytes, LSB-first, set
+ * bit = black. Pixels are 8-bit grayscale, one byte per pixel.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(FLIPIT_BUILDING_SHARED)
+#    define FLIPIT_API __declspec(dllexport)
+#  else
+#    define FLIPIT_API __declspec(dllimport)
+#  endif
+#else
+#  define FLIPIT_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLIPIT_ABI_VERSION 1
+
+typedef enum flipit_status {
+    FLIPIT_OK = 0,
+    FLIPIT_ERROR_INVALID_ARGUMENT = -1,
+    FLIPIT_ERROR_BUFFER_TOO_SMALL = -2,
+    FLIPIT_ERROR_CORRUPT_DATA = -3,
+    FLIPIT_ERROR_OUT_OF_MEMORY = -4,
+    FLIPIT_ERROR_INTERNAL = -5
+} flipit_status;
+
+typedef struct flipit_bmx_info {
+    uint32_t width;
+    uint32_t height;
+    uint8_t  is_compressed;
+    uint16_t compressed_size;
+    size_t   packed_size; /* bytes of packed bits the image decodes to */
+} flipit_bmx_info;
+
+FLIPIT_API uint32_t flipit_abi_version(void);
+FLIPIT_API const char* flipit_status_string(flipit_status status);
+
+/* Parses the BMX header without decoding the image. */
+FLIPIT_API flipit_status flipit_probe(const uint8_t* bmx, size_t bmx_size, flipit_bmx_info* info);
+
+/* BMX file bytes -> packed bits. info may be NULL. */
+FLIPIT_API flipit_status flipit_decode_bmx(const uint8_t* bmx, size_t bmx_size,
+                                           uint8_t* bits, size_t bits_capacity, size_t* out_size,
+                                           flipit_bmx_info* info);
+
+/* 8-bit grayscale pixels -> BMX file bytes, compressed when that is smaller
+ * and the stream fits the header's 16-bit size field (65535 bytes). Larger
+ * streams are stored uncompressed; flipit_probe's is_compressed reports
+ * which layout was written. */
+FLIPIT_API flipit_status flipit_encode_bmx(const uint8_t* pixels, uint32_t width, uint32_t height,
+                                           uint8_t* bmx, size_t bmx_capacity, size_t* out_size);
+
+/* Packed bits -> 8-bit grayscale pixels (black 0, white 255). */
+FLIPIT_API flipit_status flipit_expand_bits(const uint8_t* bits, size_t bits_size, uint32_t width, uint32_t height,
+                                            uint8_t* pixels, size_t pixels_capacity, size_t* out_size);
+
+/* 8-bit grayscale pixels -> packed bits (pixel < 128 is black). */
+FLIPIT_API flipit_status flipit_pack_bits(const uint8_t* pixels, uint32_t width, uint32_t height,
+                                          uint8_t* bits, size_t bits_capacity, size_t* out_size);
+
+/* Raw heatshrink streams with the BMX parameters (window 8, lookahead 4). */
+FLIPIT_API flipit_status flipit_compress(const uint8_t* input, size_t input_size,
+                                         uint8_t* output, size_t output_capacity, size_t* out_size);
+FLIPIT_API flipit_status flipit_decompress(const uint8_t* input, size_t input_size,
+                                           uint8_t* output, size_t output_capacity, size_t* out_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FLIPIT_C_H */
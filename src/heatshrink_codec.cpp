@@ -0,0 +1,5 @@
+#include "heatshrink_codec.h"
+
+// The 8/4 configuration used by BMX/BM assets is the fast path behind
+// compressHeatshrink/decompressHeatshrink; other sizes go through the C library.
+template class HeatshrinkCodec<8, 4>;
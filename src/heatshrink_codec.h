@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// heatshrink encoder/decoder with the window and lookahead sizes fixed at
+// compile time, so masks, token widths and the match index size are constants
+// and nothing besides the output is heap-allocated. Produces and accepts the
+// same bitstream as the C library: a 1 tag bit followed by an 8-bit literal,
+// or a 0 tag bit followed by (distance - 1) and (length - 1), MSB first, with
+// the window starting out zero-filled.
+template <uint8_t WindowBits, uint8_t LookaheadBits>
+class HeatshrinkCodec {
+    static_assert(WindowBits >= 4 && WindowBits <= 15, "heatshrink window must be 4..15 bits");
+    static_assert(LookaheadBits >= 3 && LookaheadBits < WindowBits, "heatshrink lookahead must be 3..window-1 bits");
+
+public:
+    static constexpr size_t WINDOW_SIZE = size_t{1} << WindowBits;
+    static constexpr size_t LOOKAHEAD_SIZE = size_t{1} << LookaheadBits;
+    static constexpr size_t WINDOW_MASK = WINDOW_SIZE - 1;
+    static constexpr size_t LITERAL_TOKEN_BITS = 1 + 8;
+    static constexpr size_t BACKREF_TOKEN_BITS = 1 + WindowBits + LookaheadBits;
+    // The encoder only emits a back-reference when it is longer than this.
+    static constexpr size_t BREAK_EVEN = BACKREF_TOKEN_BITS / 8;
+
+    static std::vector<uint8_t> decompress(const uint8_t* input, size_t input_size);
+    static std::vector<uint8_t> compress(const uint8_t* input, size_t input_size);
+    // Length in bits of what compress would produce, before padding to a
+    // byte. With start > 0, counts only the tokens from input[start] on and
+    // uses the bytes before it as the window, as when scoring a local edit.
+    static size_t compressedBits(const uint8_t* input, size_t input_size, size_t start = 0);
+
+    // Decodes into a caller-provided buffer and returns the number of bytes
+    // written. Usable in constant expressions; throws if the stream decodes
+    // to more than capacity bytes.
+    static constexpr size_t decompressInto(const uint8_t* input, size_t input_size, uint8_t* output, size_t capacity);
+
+private:
+    static constexpr int32_t NO_POSITION = std::numeric_limits<int32_t>::min();
+
+    // The encoder's greedy parse from input[start] on. Calls literal(byte) or
+    // backref(distance, length) for each token in stream order.
+    template <typename Literal, typename Backref>
+    static void parse(const uint8_t* input, size_t input_size, size_t start, Literal&& literal, Backref&& backref);
+};
+
+template <uint8_t WindowBits, uint8_t LookaheadBits>
+std::vector<uint8_t> HeatshrinkCodec<WindowBits, LookaheadBits>::decompress(const uint8_t* input, const size_t input_size) {
+    std::vector<uint8_t> output;
+    output.reserve(input_size * 2);
+
+    const size_t total_bits = input_size * 8;
+    size_t position = 0;
+
+    // Callers check that count bits remain; a token never spans more than
+    // three bytes since count <= 15.
+    auto readBits = [&](const uint8_t count) {
+        const size_t byte = position >> 3;
+        uint32_t bits = static_cast<uint32_t>(input[byte]) << 16;
+        if (byte + 1 < input_size) bits |= static_cast<uint32_t>(input[byte + 1]) << 8;
+        if (byte + 2 < input_size) bits |= input[byte + 2];
+        position += count;
+        return (bits >> (24 - ((position - count) & 7) - count)) & ((1u << count) - 1);
+    };
+
+    while (position < total_bits) {
+        const bool is_literal = (input[position >> 3] >> (7 - (position & 7))) & 1;
+        if (total_bits - position < (is_literal ? LITERAL_TOKEN_BITS : BACKREF_TOKEN_BITS)) break;
+        ++position;
+
+        if (is_literal) {
+            output.push_back(static_cast<uint8_t>(readBits(8)));
+            continue;
+        }
+
+        const size_t distance = readBits(WindowBits) + 1;
+        const size_t length = readBits(LookaheadBits) + 1;
+
+        // The decoded output doubles as the window; anything before the
+        // start of the stream reads as the zero-filled initial window.
+        const size_t start = output.size();
+        output.resize(start + length);
+        for (size_t i = start; i < start + length; ++i)
+            output[i] = i >= distance ? output[i - distance] : 0;
+    }
+
+    return output;
+}
+
+template <uint8_t WindowBits, uint8_t LookaheadBits>
+constexpr size_t HeatshrinkCodec<WindowBits, LookaheadBits>::decompressInto(const uint8_t* input, const size_t input_size,
+                                                                           uint8_t* output, const size_t capacity) {
+    const size_t total_bits = input_size * 8;
+    size_t position = 0;
+    size_t written = 0;
+
+    auto readBits = [&](const uint8_t count) {
+        uint32_t value = 0;
+        for (uint8_t i = 0; i < count; ++i, ++position)
+            value = (value << 1) | ((input[position >> 3] >> (7 - (position & 7))) & 1);
+        return value;
+    };
+
+    while (position < total_bits) {
+        const bool is_literal = (input[position >> 3] >> (7 - (position & 7))) & 1;
+        if (total_bits - position < (is_literal ? LITERAL_TOKEN_BITS : BACKREF_TOKEN_BITS)) break;
+        ++position;
+
+        const size_t distance = is_literal ? 0 : readBits(WindowBits) + 1;
+        const size_t length = is_literal ? 1 : readBits(LookaheadBits) + 1;
+        if (written + length > capacity) throw std::length_error("heatshrink stream exceeds output buffer");
+
+        if (is_literal) {
+            output[written++] = static_cast<uint8_t>(readBits(8));
+            continue;
+        }
+        for (const size_t end = written + length; written < end; ++written)
+            output[written] = written >= distance ? output[written - distance] : 0;
+    }
+
+    return written;
+}
+
+template <uint8_t WindowBits, uint8_t LookaheadBits>
+std::vector<uint8_t> HeatshrinkCodec<WindowBits, LookaheadBits>::compress(const uint8_t* input, const size_t input_size) {
+    std::vector<uint8_t> output;
+    output.reserve(input_size + input_size / 8 + 1);
+
+    uint32_t bit_buffer = 0;
+    uint8_t bit_count = 0;
+    auto pushBits = [&](const uint32_t value, const uint8_t count) {
+        bit_buffer = (bit_buffer << count) | value;
+        bit_count += count;
+        while (bit_count >= 8) {
+            bit_count -= 8;
+            output.push_back(static_cast<uint8_t>(bit_buffer >> bit_count));
+        }
+    };
+
+    parse(input, input_size, 0,
+          [&](const uint8_t byte) { pushBits((1u << 8) | byte, 9); },
+          [&](const int32_t distance, const int32_t length) {
+              pushBits(0, 1);
+              pushBits(static_cast<uint32_t>(distance - 1), WindowBits);
+              pushBits(static_cast<uint32_t>(length - 1), LookaheadBits);
+          });
+
+    if (bit_count > 0) output.push_back(static_cast<uint8_t>(bit_buffer << (8 - bit_count)));
+    return output;
+}
+
+template <uint8_t WindowBits, uint8_t LookaheadBits>
+size_t HeatshrinkCodec<WindowBits, LookaheadBits>::compressedBits(const uint8_t* input, const size_t input_size, const size_t start) {
+    size_t bits = 0;
+    parse(input, input_size, start,
+          [&](uint8_t) { bits += LITERAL_TOKEN_BITS; },
+          [&](int32_t, int32_t) { bits += BACKREF_TOKEN_BITS; });
+    return bits;
+}
+
+template <uint8_t WindowBits, uint8_t LookaheadBits>
+template <typename Literal, typename Backref>
+void HeatshrinkCodec<WindowBits, LookaheadBits>::parse(const uint8_t* input, const size_t input_size, const size_t start,
+                                                        Literal&& literal, Backref&& backref) {
+    // Byte at a (possibly negative) stream position; the window starts zeroed.
+    auto at = [input](const int32_t pos) -> uint8_t { return pos < 0 ? 0 : input[pos]; };
+
+    // Chain of earlier positions holding the same byte, newest first, like
+    // heatshrink's match index. Positions below zero are the zeroed window, so
+    // the chain for byte 0 continues -1, -2, ... into it.
+    std::array<int32_t, 256> head;
+    head.fill(NO_POSITION);
+    head[0] = -1;
+    std::array<int32_t, WINDOW_SIZE> previous{};
+
+    auto insert = [&](const int32_t pos) {
+        const uint8_t value = input[pos];
+        previous[pos & WINDOW_MASK] = head[value];
+        head[value] = pos;
+    };
+    auto next = [&](const int32_t pos) { return pos < 0 ? pos - 1 : previous[pos & WINDOW_MASK]; };
+
+    const auto size = static_cast<int32_t>(input_size);
+    int32_t p = 0;
+    for (const auto history = static_cast<int32_t>(std::min(start, input_size)); p < history; ++p) insert(p);
+    while (p < size) {
+        const int32_t max_length = std::min<int32_t>(LOOKAHEAD_SIZE, size - p);
+        const int32_t oldest = p - static_cast<int32_t>(WINDOW_SIZE);
+        const uint8_t* needle = input + p;
+
+        int32_t best_length = 0;
+        int32_t best_pos = 0;
+        for (int32_t pos = head[needle[0]]; pos != NO_POSITION && pos >= oldest; pos = next(pos)) {
+            if (at(pos + best_length) != needle[best_length]) continue;
+            int32_t length = 1;
+            while (length < max_length && at(pos + length) == needle[length]) ++length;
+            if (length > best_length) {
+                best_length = length;
+                best_pos = pos;
+                if (length == max_length) break;
+            }
+        }
+
+        if (static_cast<size_t>(best_length) > BREAK_EVEN) {
+            backref(p - best_pos, best_length);
+        } else {
+            best_length = 1;
+            literal(needle[0]);
+        }
+
+        for (const int32_t end = p + best_length; p < end; ++p) insert(p);
+    }
+}
+
+extern template class HeatshrinkCodec<8, 4>;
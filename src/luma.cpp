@@ -0,0 +1,167 @@
+#include "luma.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+    template <int Channels>
+    uint32_t scaledLuma(const uint8_t* p, const uint8_t background) {
+        if constexpr (Channels == 1) return compositeLuma(p[0] * 256u, 255, background);
+        if constexpr (Channels == 2) return compositeLuma(p[0] * 256u, p[1], background);
+        if constexpr (Channels == 3) return compositeLuma(lumaSum(p[0], p[1], p[2]), 255, background);
+        if constexpr (Channels == 4) return compositeLuma(lumaSum(p[0], p[1], p[2]), p[3], background);
+    }
+
+    template <int Channels>
+    void lumaRows(const uint8_t* pixels, const size_t count, const uint8_t background, uint8_t* out) {
+        for (size_t i = 0; i < count; ++i)
+            out[i] = static_cast<uint8_t>(scaledLuma<Channels>(pixels + i * Channels, background) / (256 * 255));
+    }
+
+    // Whole bytes take a fixed 8-pixel body the compiler can vectorize; only
+    // the last byte of a row with a partial byte is handled pixel by pixel.
+    template <int Channels>
+    void packRows(const uint8_t* pixels, const uint32_t width, const uint32_t height, const uint8_t background,
+                  const uint32_t black_below, uint8_t* out) {
+        const size_t bytes_per_row = (width + 7) / 8;
+        const size_t full_bytes = width / 8;
+        for (uint32_t y = 0; y < height; ++y) {
+            const uint8_t* row = pixels + static_cast<size_t>(y) * width * Channels;
+            uint8_t* bits = out + y * bytes_per_row;
+            for (size_t b = 0; b < full_bytes; ++b) {
+                const uint8_t* p = row + b * 8 * Channels;
+                uint8_t byte = 0;
+                for (int k = 0; k < 8; ++k)
+                    byte |= static_cast<uint8_t>(scaledLuma<Channels>(p + k * Channels, background) < black_below) << k;
+                bits[b] = byte;
+            }
+            if (full_bytes < bytes_per_row) {
+                uint8_t byte = 0;
+                for (uint32_t x = static_cast<uint32_t>(full_bytes * 8); x < width; ++x)
+                    byte |= static_cast<uint8_t>(scaledLuma<Channels>(row + x * Channels, background) < black_below) << (x % 8);
+                bits[full_bytes] = byte;
+            }
+        }
+    }
+
+    // Four interleaved sub-histograms, so consecutive pixels of the same
+    // level do not wait on each other's increment; summed at the end.
+    template <int Channels>
+    std::array<uint32_t, 256> histogramOf(const uint8_t* pixels, const size_t count, const uint8_t background) {
+        std::array<std::array<uint32_t, 256>, 4> partial{};
+        const auto level = [&](const size_t i) {
+            if constexpr (Channels == 1) return pixels[i];
+            else return static_cast<uint8_t>(scaledLuma<Channels>(pixels + i * Channels, background) / (256 * 255));
+        };
+        size_t i = 0;
+        if constexpr (Channels == 1) {
+            // Icons are mostly long runs of one level: a block whose 32 bytes
+            // all equal its first is one add instead of 32 increments.
+            constexpr size_t BLOCK = 32;
+            for (; i + BLOCK <= count; i += BLOCK) {
+                uint64_t words[BLOCK / 8];
+                std::memcpy(words, pixels + i, BLOCK);
+                const uint64_t first = (words[0] & 0xFF) * 0x0101010101010101ull;
+                uint64_t differs = 0;
+                for (const uint64_t word : words) differs |= word ^ first;
+                if (differs == 0) {
+                    partial[0][pixels[i]] += BLOCK;
+                    continue;
+                }
+                for (size_t k = i; k < i + BLOCK; k += 4) {
+                    ++partial[0][pixels[k]];
+                    ++partial[1][pixels[k + 1]];
+                    ++partial[2][pixels[k + 2]];
+                    ++partial[3][pixels[k + 3]];
+                }
+            }
+        }
+        for (; i + 4 <= count; i += 4) {
+            ++partial[0][level(i)];
+            ++partial[1][level(i + 1)];
+            ++partial[2][level(i + 2)];
+            ++partial[3][level(i + 3)];
+        }
+        for (; i < count; ++i) ++partial[0][level(i)];
+
+        std::array<uint32_t, 256> histogram{};
+        for (int v = 0; v < 256; ++v) histogram[v] = partial[0][v] + partial[1][v] + partial[2][v] + partial[3][v];
+        return histogram;
+    }
+}
+
+std::vector<uint8_t> convertToLuma(const uint8_t* pixels, const uint32_t width, const uint32_t height, const int channels,
+                                   const uint8_t background) {
+    TraceScope trace("luma");
+    std::vector<uint8_t> luma(static_cast<size_t>(width) * height);
+    convertToLuma(pixels, luma.size(), channels, background, luma.data());
+    return luma;
+}
+
+void convertToLuma(const uint8_t* pixels, const size_t count, const int channels, const uint8_t background, uint8_t* out) {
+    switch (channels) {
+        case 1: lumaRows<1>(pixels, count, background, out); break;
+        case 2: lumaRows<2>(pixels, count, background, out); break;
+        case 3: lumaRows<3>(pixels, count, background, out); break;
+        case 4: lumaRows<4>(pixels, count, background, out); break;
+        default: throw std::runtime_error("Unsupported channel count: " + std::to_string(channels));
+    }
+}
+
+std::vector<uint8_t> convertToBitData(const uint8_t* pixels, const uint32_t width, const uint32_t height, const int channels,
+                                      const uint8_t background, const int threshold) {
+    TraceScope trace("threshold/pack");
+    std::vector<uint8_t> bitData(static_cast<size_t>((width + 7) / 8) * height);
+    const uint32_t black_below = scaledThreshold(std::clamp(threshold, 0, 256));
+    switch (channels) {
+        case 1: packRows<1>(pixels, width, height, background, black_below, bitData.data()); break;
+        case 2: packRows<2>(pixels, width, height, background, black_below, bitData.data()); break;
+        case 3: packRows<3>(pixels, width, height, background, black_below, bitData.data()); break;
+        case 4: packRows<4>(pixels, width, height, background, black_below, bitData.data()); break;
+        default: throw std::runtime_error("Unsupported channel count: " + std::to_string(channels));
+    }
+    return bitData;
+}
+
+std::array<uint32_t, 256> lumaHistogram(const uint8_t* pixels, const uint32_t width, const uint32_t height, const int channels,
+                                        const uint8_t background) {
+    TraceScope trace("histogram");
+    const size_t count = static_cast<size_t>(width) * height;
+    switch (channels) {
+        case 1: return histogramOf<1>(pixels, count, background);
+        case 2: return histogramOf<2>(pixels, count, background);
+        case 3: return histogramOf<3>(pixels, count, background);
+        case 4: return histogramOf<4>(pixels, count, background);
+        default: throw std::runtime_error("Unsupported channel count: " + std::to_string(channels));
+    }
+}
+
+int otsuThreshold(const std::array<uint32_t, 256>& histogram) {
+    uint64_t total = 0, total_sum = 0;
+    for (int v = 0; v < 256; ++v) {
+        total += histogram[v];
+        total_sum += static_cast<uint64_t>(v) * histogram[v];
+    }
+
+    // Split below t: between-class variance is proportional to
+    // (mean_below - mean_above)^2 * count_below * count_above.
+    int best = DEFAULT_THRESHOLD;
+    double best_variance = 0;
+    uint64_t below = 0, below_sum = 0;
+    for (int t = 1; t < 256; ++t) {
+        below += histogram[t - 1];
+        below_sum += static_cast<uint64_t>(t - 1) * histogram[t - 1];
+        const uint64_t above = total - below;
+        if (below == 0 || above == 0) continue;
+        const double difference = static_cast<double>(below_sum) / below - static_cast<double>(total_sum - below_sum) / above;
+        const double variance = difference * difference * static_cast<double>(below) * static_cast<double>(above);
+        if (variance > best_variance) {
+            best_variance = variance;
+            best = t;
+        }
+    }
+    return best;
+}
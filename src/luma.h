@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Gray conversion for images with 1 (gray), 2 (gray + alpha), 3 (RGB) or
+// 4 (RGBA) 8-bit channels. Alpha is composited over a gray background before
+// the luma weights apply, so transparent areas take the background's shade
+// instead of whatever color data they happen to hold. Opaque pixels give the
+// same gray value as stbi_load(..., 1).
+
+constexpr uint8_t DEFAULT_BACKGROUND = 255;
+
+// stb's luma weights; they sum to 256, so gray g gives 256 * g.
+constexpr uint32_t lumaSum(const uint32_t r, const uint32_t g, const uint32_t b) {
+    return r * 77 + g * 150 + b * 29;
+}
+
+// Luma composited over the background, scaled by 256 * 255 so everything
+// stays in integers.
+constexpr uint32_t compositeLuma(const uint32_t luma_sum, const uint32_t alpha, const uint8_t background) {
+    return luma_sum * alpha + 256u * background * (255 - alpha);
+}
+
+// Gray below the threshold is black. Scaled luma is compared against
+// scaledThreshold(threshold); threshold may be 0..256.
+constexpr int DEFAULT_THRESHOLD = 128;
+constexpr uint32_t scaledThreshold(const int threshold) {
+    return static_cast<uint32_t>(threshold) * 256 * 255;
+}
+constexpr uint32_t BLACK_BELOW = scaledThreshold(DEFAULT_THRESHOLD);
+
+std::vector<uint8_t> convertToLuma(const uint8_t* pixels, uint32_t width, uint32_t height, int channels,
+                                   uint8_t background = DEFAULT_BACKGROUND);
+// The same for count pixels (say one row) into a caller's buffer.
+void convertToLuma(const uint8_t* pixels, size_t count, int channels, uint8_t background, uint8_t* out);
+
+// Composite, luma and threshold fused into one pass that writes packed bits.
+std::vector<uint8_t> convertToBitData(const uint8_t* pixels, uint32_t width, uint32_t height, int channels,
+                                      uint8_t background = DEFAULT_BACKGROUND, int threshold = DEFAULT_THRESHOLD);
+
+// Histogram of the composited gray levels, without materializing them.
+std::array<uint32_t, 256> lumaHistogram(const uint8_t* pixels, uint32_t width, uint32_t height, int channels,
+                                        uint8_t background = DEFAULT_BACKGROUND);
+
+// Otsu's method: the threshold (gray < threshold is black) that maximizes the
+// between-class variance. Single-level images keep DEFAULT_THRESHOLD.
+int otsuThreshold(const std::array<uint32_t, 256>& histogram);
@@ -0,0 +1,70 @@
+#include "pbm.h"
+#include "bit_reverse.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace {
+    bool isSpace(const uint8_t c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    uint32_t readNumber(const uint8_t* data, const size_t size, size_t& pos) {
+        while (pos < size && (isSpace(data[pos]) || data[pos] == '#')) {
+            if (data[pos] == '#') while (pos < size && data[pos] != '\n') ++pos;
+            else ++pos;
+        }
+        if (pos >= size || data[pos] < '0' || data[pos] > '9') throw std::runtime_error("Malformed PBM header");
+        uint64_t value = 0;
+        for (; pos < size && data[pos] >= '0' && data[pos] <= '9'; ++pos) {
+            value = value * 10 + (data[pos] - '0');
+            if (value > UINT32_MAX) throw std::runtime_error("PBM dimension out of range");
+        }
+        return static_cast<uint32_t>(value);
+    }
+}
+
+size_t readPbmHeader(const uint8_t* data, const size_t size, uint32_t& width, uint32_t& height) {
+    if (size < 2 || data[0] != 'P' || data[1] != '4') throw std::runtime_error("Expected a binary PBM (P4) image");
+    size_t pos = 2;
+    width = readNumber(data, size, pos);
+    height = readNumber(data, size, pos);
+    // Exactly one whitespace byte separates the header from the raster.
+    if (pos >= size || !isSpace(data[pos])) throw std::runtime_error("Malformed PBM header");
+    if (width == 0 || height == 0) throw std::runtime_error("Invalid PBM dimensions");
+    return pos + 1;
+}
+
+void clearRowPadding(uint8_t* bits, const uint32_t width, const uint32_t height) {
+    const uint32_t tail = width % 8;
+    if (tail == 0) return;
+    const size_t row_bytes = (width + 7) / 8;
+    const auto mask = static_cast<uint8_t>((1u << tail) - 1);
+    for (size_t y = 0; y < height; ++y) bits[y * row_bytes + row_bytes - 1] &= mask;
+}
+
+std::vector<uint8_t> decodePBM(const std::vector<uint8_t>& pbm, uint32_t& width, uint32_t& height) {
+    TraceScope trace("decode pbm");
+    const size_t offset = readPbmHeader(pbm.data(), pbm.size(), width, height);
+    const size_t raster_size = static_cast<size_t>(height) * ((width + 7) / 8);
+    if (pbm.size() - offset < raster_size) throw std::runtime_error("Truncated PBM raster");
+
+    std::vector<uint8_t> bits(raster_size);
+    reverseBits(pbm.data() + offset, bits.data(), raster_size);
+    clearRowPadding(bits.data(), width, height);
+    return bits;
+}
+
+std::vector<uint8_t> encodePBM(const std::vector<uint8_t>& bitData, const uint32_t width, const uint32_t height) {
+    TraceScope trace("encode pbm");
+    const std::string header = "P4\n" + std::to_string(width) + " " + std::to_string(height) + "\n";
+    const size_t raster_size = static_cast<size_t>(height) * ((width + 7) / 8);
+    const size_t available = std::min(raster_size, bitData.size());
+
+    std::vector<uint8_t> pbm(header.size() + raster_size, 0);
+    std::copy(header.begin(), header.end(), pbm.begin());
+    reverseBits(bitData.data(), pbm.data() + header.size(), available);
+    return pbm;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Netpbm P4 (raw PBM): 1 = black, rows padded to whole bytes, MSB-first.
+// That is BMX bit data with the bit order of each byte reversed, so both
+// directions are a header plus one reverseBits pass, without 8-bit pixels.
+
+// Parses a P4 header. Returns the offset of the raster, which is
+// height * ((width + 7) / 8) bytes long.
+size_t readPbmHeader(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height);
+
+// P4 row padding is don't-care; BMX bits keep it clear (as convertToBitData
+// does). Clears the bits past width in the last byte of each packed row.
+void clearRowPadding(uint8_t* bits, uint32_t width, uint32_t height);
+
+// First image of a P4 file to BMX packed bits.
+std::vector<uint8_t> decodePBM(const std::vector<uint8_t>& pbm, uint32_t& width, uint32_t& height);
+
+// BMX packed bits to a P4 file. Missing trailing bytes are written as white.
+std::vector<uint8_t> encodePBM(const std::vector<uint8_t>& bitData, uint32_t width, uint32_t height);
@@ -0,0 +1,116 @@
+#include "perf_counters.h"
+
+#include <utility>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char* perfCounterName(const PerfCounter counter) {
+    switch (counter) {
+        case PerfCounter::Cycles: return "cycles";
+        case PerfCounter::Instructions: return "instructions";
+        case PerfCounter::BranchMisses: return "branch-misses";
+        case PerfCounter::L1DMisses: return "L1d-misses";
+        case PerfCounter::CacheMisses: return "cache-misses";
+        default: return "unknown";
+    }
+}
+
+#ifdef __linux__
+
+namespace {
+    // Members of a group are enabled and disabled with their leader, so only
+    // the leader starts disabled.
+    int openCounter(const uint32_t type, const uint64_t config, const int group_fd) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = group_fd < 0;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+    }
+
+    constexpr uint64_t cacheReadMiss(const uint64_t cache) {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+}
+
+PerfCounters::PerfCounters() {
+    constexpr std::array<std::pair<uint32_t, uint64_t>, PERF_COUNTER_COUNT> events = {{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_L1D)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    }};
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        fds[i] = openCounter(events[i].first, events[i].second, leader);
+        if (leader < 0) leader = fds[i];
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    // Members first; closing the leader would turn them into singletons.
+    for (const int fd : fds)
+        if (fd >= 0 && fd != leader) close(fd);
+    if (leader >= 0) close(leader);
+}
+
+bool PerfCounters::available() const {
+    for (const int fd : fds)
+        if (fd >= 0) return true;
+    return false;
+}
+
+void PerfCounters::start() {
+    if (leader < 0) return;
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+PerfCounterValues PerfCounters::stop() {
+    if (leader >= 0) ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // Read per counter: inherited (per-thread) counters cannot be read with
+    // PERF_FORMAT_GROUP on older kernels, and each read sums the threads.
+    PerfCounterValues result;
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (fds[i] < 0) continue;
+        uint64_t data[3] = {}; // value, time enabled, time running
+        if (read(fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) continue;
+        // Scale up for the share of time the PMU spent on other events.
+        result.values[i] = data[2] < data[1]
+            ? static_cast<uint64_t>(static_cast<double>(data[0]) * static_cast<double>(data[1]) / static_cast<double>(data[2]))
+            : data[0];
+        result.valid[i] = true;
+    }
+    return result;
+}
+
+#else
+
+PerfCounters::PerfCounters() {
+    fds.fill(-1);
+}
+
+PerfCounters::~PerfCounters() = default;
+
+bool PerfCounters::available() const {
+    return false;
+}
+
+void PerfCounters::start() {}
+
+PerfCounterValues PerfCounters::stop() {
+    return {};
+}
+
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Hardware performance counters via Linux perf_event_open. On other platforms,
+// or when the kernel refuses access (perf_event_paranoid, containers), the
+// individual counters simply report as unavailable.
+//
+// The counters are opened as one group so they cover the same interval, and
+// values are scaled by enabled/running time when the PMU had to multiplex
+// them. Threads created after construction (including the library's lazily
+// started pools) are counted along with the calling thread; threads that
+// already existed are not.
+enum class PerfCounter : uint8_t {
+    Cycles,
+    Instructions,
+    BranchMisses,
+    L1DMisses,
+    CacheMisses, // generic PERF_COUNT_HW_CACHE_MISSES; the PMU driver picks the level (usually LLC)
+    Count
+};
+
+constexpr size_t PERF_COUNTER_COUNT = static_cast<size_t>(PerfCounter::Count);
+
+const char* perfCounterName(PerfCounter counter);
+
+struct PerfCounterValues {
+    std::array<uint64_t, PERF_COUNTER_COUNT> values{};
+    std::array<bool, PERF_COUNTER_COUNT> valid{};
+
+    bool has(PerfCounter counter) const { return valid[static_cast<size_t>(counter)]; }
+    uint64_t get(PerfCounter counter) const { return values[static_cast<size_t>(counter)]; }
+};
+
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const;
+
+    void start();
+    PerfCounterValues stop();
+
+private:
+    std::array<int, PERF_COUNTER_COUNT> fds;
+    int leader = -1; // first counter opened; the others join its group
+};
@@ -0,0 +1,173 @@
+#include "png_reader.h"
+#include "bit_reverse.h"
+#include "luma.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "stb_image.h"
+
+namespace {
+    constexpr uint8_t PNG_SIGNATURE[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    uint32_t readU16(const uint8_t* p) {
+        return static_cast<uint32_t>(p[0]) << 8 | p[1];
+    }
+
+    uint32_t readU32(const uint8_t* p) {
+        return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 | static_cast<uint32_t>(p[2]) << 8 | p[3];
+    }
+
+    uint8_t paeth(const int a, const int b, const int c) {
+        const int p = a + b - c;
+        const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+        return static_cast<uint8_t>(pb <= pc ? b : c);
+    }
+
+    // Undoes the row filter in place. Below 8 bits per pixel the filters work
+    // on whole bytes with a left neighbour one byte back.
+    bool unfilterRow(const uint8_t filter, uint8_t* row, const uint8_t* previous, const size_t size) {
+        switch (filter) {
+            case 0:
+                return true;
+            case 1:
+                for (size_t i = 1; i < size; ++i) row[i] += row[i - 1];
+                return true;
+            case 2:
+                for (size_t i = 0; i < size; ++i) row[i] += previous[i];
+                return true;
+            case 3:
+                for (size_t i = 0; i < size; ++i) row[i] += ((i ? row[i - 1] : 0) + previous[i]) >> 1;
+                return true;
+            case 4:
+                for (size_t i = 0; i < size; ++i)
+                    row[i] += paeth(i ? row[i - 1] : 0, previous[i], i ? previous[i - 1] : 0);
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+bool decodePackedPNG(const std::vector<uint8_t>& png, std::vector<uint8_t>& bits, uint32_t& width, uint32_t& height,
+                     const uint8_t background, int threshold, int* used_threshold) {
+    TraceScope trace("png decode (1-bit)");
+    if (png.size() < sizeof(PNG_SIGNATURE) + 25 || std::memcmp(png.data(), PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) != 0) return false;
+
+    uint32_t w = 0, h = 0;
+    bool palette = false;
+    // Scaled luma and alpha of the two sample values; grayscale 0 is black.
+    std::array<uint32_t, 2> luma{0, lumaSum(255, 255, 255)};
+    std::array<uint32_t, 2> alpha{255, 255};
+    size_t palette_entries = 0;
+    std::vector<uint8_t> idat;
+
+    size_t pos = sizeof(PNG_SIGNATURE);
+    bool seen_header = false;
+    while (pos + 12 <= png.size()) {
+        const uint32_t length = readU32(&png[pos]);
+        const uint8_t* type = &png[pos + 4];
+        const uint8_t* data = &png[pos + 8];
+        if (length > png.size() - pos - 12) return false;
+
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            if (length != 13) return false;
+            w = readU32(data);
+            h = readU32(data + 4);
+            const uint8_t bit_depth = data[8], color_type = data[9], interlace = data[12];
+            if (bit_depth != 1 || (color_type != 0 && color_type != 3) || interlace != 0 || data[10] != 0 || data[11] != 0) return false;
+            palette = color_type == 3;
+            seen_header = true;
+        } else if (!seen_header) {
+            return false;
+        } else if (std::memcmp(type, "PLTE", 4) == 0) {
+            if (length % 3 != 0) return false;
+            palette_entries = length / 3;
+            for (size_t i = 0; i < 2 && i < palette_entries; ++i) luma[i] = lumaSum(data[3 * i], data[3 * i + 1], data[3 * i + 2]);
+        } else if (std::memcmp(type, "tRNS", 4) == 0) {
+            // Palette: one alpha per entry. Grayscale: the sample value that is fully transparent.
+            if (palette) {
+                for (size_t i = 0; i < 2 && i < length; ++i) alpha[i] = data[i];
+            } else if (length == 2 && (readU16(data) & 1) == readU16(data)) {
+                alpha[readU16(data)] = 0;
+            }
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+            idat.insert(idat.end(), data, data + length);
+        } else if (std::memcmp(type, "IEND", 4) == 0) {
+            break;
+        } else if (!(type[0] & 0x20)) {
+            return false; // unknown critical chunk
+        }
+        pos += 12 + static_cast<size_t>(length);
+    }
+    // An index without a palette entry is an error stb reports; leave it to stb.
+    if (!seen_header || w == 0 || h == 0 || idat.empty() || (palette && palette_entries < 2)) return false;
+
+    const size_t row_bytes = (static_cast<size_t>(w) + 7) / 8;
+    if (row_bytes + 1 > static_cast<size_t>(INT32_MAX) / h) return false;
+    std::vector<uint8_t> raw((row_bytes + 1) * h);
+    const int inflated = stbi_zlib_decode_buffer(reinterpret_cast<char*>(raw.data()), static_cast<int>(raw.size()),
+                                                 reinterpret_cast<const char*>(idat.data()), static_cast<int>(idat.size()));
+    if (inflated != static_cast<int>(raw.size())) return false;
+
+    // PNG bit v is gray level[v] once composited; BMX sets the bit for black.
+    std::array<uint32_t, 2> level{};
+    for (size_t i = 0; i < 2; ++i) level[i] = compositeLuma(luma[i], alpha[i], background) / scaledThreshold(1);
+    const auto isBlack = [&](const size_t v) { return level[v] < static_cast<uint32_t>(threshold); };
+    // convertToBitData leaves the padding bits of each row clear.
+    const auto clearPadding = [&](std::vector<uint8_t>& packed) {
+        if (const uint32_t tail = w % 8) {
+            const uint8_t mask = static_cast<uint8_t>((1u << tail) - 1);
+            for (size_t y = 0; y < h; ++y) packed[y * row_bytes + row_bytes - 1] &= mask;
+        }
+    };
+
+    // Auto threshold needs the count of each level, so the sample bits are
+    // unpacked as they are and mapped to black afterwards.
+    const bool automatic = threshold < 0;
+    std::vector<uint8_t> packed;
+    if (!automatic && isBlack(0) == isBlack(1)) {
+        packed.assign(row_bytes * h, isBlack(0) ? 0xFF : 0x00);
+    } else {
+        const uint8_t invert = !automatic && isBlack(0) ? 0xFF : 0x00;
+        const std::vector<uint8_t> zero_row(row_bytes, 0);
+        packed.resize(row_bytes * h);
+        for (size_t y = 0; y < h; ++y) {
+            uint8_t* row = &raw[y * (row_bytes + 1)];
+            const uint8_t* previous = y ? row - row_bytes : zero_row.data();
+            if (!unfilterRow(row[0], row + 1, previous, row_bytes)) return false;
+            uint8_t* out = &packed[y * row_bytes];
+            reverseBits(row + 1, out, row_bytes, invert);
+        }
+    }
+    clearPadding(packed);
+
+    if (automatic) {
+        size_t ones = 0;
+        for (const uint8_t byte : packed) ones += std::popcount(byte);
+        std::array<uint32_t, 256> histogram{};
+        histogram[level[0]] += static_cast<uint32_t>(static_cast<size_t>(w) * h - ones);
+        histogram[level[1]] += static_cast<uint32_t>(ones);
+        threshold = otsuThreshold(histogram);
+        if (isBlack(0) == isBlack(1)) {
+            std::fill(packed.begin(), packed.end(), isBlack(0) ? 0xFF : 0x00);
+            clearPadding(packed);
+        } else if (isBlack(0)) {
+            for (uint8_t& byte : packed) byte = static_cast<uint8_t>(~byte);
+            clearPadding(packed);
+        }
+    }
+
+    bits = std::move(packed);
+    width = w;
+    height = h;
+    if (used_threshold) *used_threshold = threshold;
+    return true;
+}
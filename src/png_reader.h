@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Fast path for the PNGs most icons are drawn as: bit depth 1, grayscale or
+// a palette of at most two colors, not interlaced. The rows are inflated and
+// mapped straight to packed BMX bits (LSB-first, set bit = black) with the
+// same black/white decision stbi_load + convertToBitData would make, so there
+// is no 8-bit image in between.
+//
+// Transparency (tRNS) is composited over the background gray as decodeImageBits
+// does for other images. Gray below threshold is black; a negative threshold
+// picks Otsu's from the two levels' pixel counts. used_threshold receives the
+// value applied.
+//
+// Returns false, leaving the outputs untouched, for any PNG outside that
+// subset (or anything that is not a PNG); callers then fall back to stb.
+bool decodePackedPNG(const std::vector<uint8_t>& png, std::vector<uint8_t>& bits, uint32_t& width, uint32_t& height,
+                     uint8_t background = 255, int threshold = 128, int* used_threshold = nullptr);
@@ -0,0 +1,198 @@
+#include "png_writer.h"
+#include "bit_reverse.h"
+#include "deflate.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+extern "C" int stbi_write_png_compression_level;
+
+namespace {
+    constexpr uint8_t PNG_SIGNATURE[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    constexpr std::array<uint32_t, 256> makeCrcTable() {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        return table;
+    }
+    constexpr auto CRC_TABLE = makeCrcTable();
+
+    void appendU32(std::vector<uint8_t>& out, const uint32_t value) {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void appendU16(std::vector<uint8_t>& out, const uint16_t value) {
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void appendChunk(std::vector<uint8_t>& out, const char type[4], const std::vector<uint8_t>& data) {
+        appendU32(out, static_cast<uint32_t>(data.size()));
+        const size_t crc_start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = crc_start; i < out.size(); ++i) crc = CRC_TABLE[(crc ^ out[i]) & 0xFF] ^ (crc >> 8);
+        appendU32(out, crc ^ 0xFFFFFFFFu);
+    }
+
+    std::vector<uint8_t> deflate(const std::vector<uint8_t>& raw) {
+        return zlibCompress(raw.data(), raw.size(), stbi_write_png_compression_level);
+    }
+
+    // IHDR + PLTE of a 1-bit palette image: index 0 white, index 1 black, so
+    // the BMX bit value is the palette index.
+    void appendHeader(std::vector<uint8_t>& out, const uint32_t width, const uint32_t height) {
+        out.insert(out.end(), std::begin(PNG_SIGNATURE), std::end(PNG_SIGNATURE));
+
+        std::vector<uint8_t> ihdr;
+        appendU32(ihdr, width);
+        appendU32(ihdr, height);
+        ihdr.insert(ihdr.end(), {1, 3, 0, 0, 0}); // bit depth, palette color type, deflate, adaptive filters, no interlace
+        appendChunk(out, "IHDR", ihdr);
+        appendChunk(out, "PLTE", {0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00});
+    }
+
+    struct Rect {
+        uint32_t x = 0, y = 0, width = 0, height = 0;
+    };
+
+    // Smallest rectangle, widened to whole bytes, that covers every difference.
+    // Empty when the frames are identical.
+    Rect changedRect(const std::vector<uint8_t>& previous, const std::vector<uint8_t>& current,
+                     const uint32_t width, const uint32_t height) {
+        const size_t row_bytes = (width + 7) / 8;
+        size_t min_row = height, max_row = 0, min_byte = row_bytes, max_byte = 0;
+        for (size_t y = 0; y < height; ++y) {
+            const uint8_t* a = previous.data() + y * row_bytes;
+            const uint8_t* b = current.data() + y * row_bytes;
+            for (size_t i = 0; i < row_bytes; ++i) {
+                if (a[i] == b[i]) continue;
+                min_row = std::min(min_row, y);
+                max_row = y;
+                min_byte = std::min(min_byte, i);
+                max_byte = std::max(max_byte, i);
+            }
+        }
+        if (min_row == height) return {};
+
+        Rect rect;
+        rect.x = static_cast<uint32_t>(min_byte * 8);
+        rect.y = static_cast<uint32_t>(min_row);
+        rect.width = std::min(width, static_cast<uint32_t>((max_byte + 1) * 8)) - rect.x;
+        rect.height = static_cast<uint32_t>(max_row - min_row + 1);
+        return rect;
+    }
+
+    // Filter-type-0 scanlines of a byte-aligned rectangle, bit order flipped for PNG.
+    std::vector<uint8_t> scanlines(const std::vector<uint8_t>& bits, const uint32_t width, const Rect& rect) {
+        const size_t row_bytes = (width + 7) / 8;
+        const size_t rect_bytes = (rect.width + 7) / 8;
+        std::vector<uint8_t> raw;
+        raw.reserve((rect_bytes + 1) * rect.height);
+        for (uint32_t y = rect.y; y < rect.y + rect.height; ++y) {
+            raw.push_back(0);
+            const uint8_t* row = bits.data() + y * row_bytes + rect.x / 8;
+            raw.resize(raw.size() + rect_bytes);
+            reverseBits(row, raw.data() + raw.size() - rect_bytes, rect_bytes);
+        }
+        return raw;
+    }
+
+    std::vector<uint8_t> frameControl(const uint32_t sequence, const Rect& rect, const uint16_t delay_num, const uint16_t delay_den) {
+        std::vector<uint8_t> fctl;
+        appendU32(fctl, sequence);
+        appendU32(fctl, rect.width);
+        appendU32(fctl, rect.height);
+        appendU32(fctl, rect.x);
+        appendU32(fctl, rect.y);
+        appendU16(fctl, delay_num);
+        appendU16(fctl, delay_den);
+        fctl.push_back(0); // dispose: leave the canvas as is
+        fctl.push_back(0); // blend: replace the rectangle
+        return fctl;
+    }
+}
+
+void setPngCompressionLevel(const int level) {
+    stbi_write_png_compression_level = std::clamp(level, 0, MAX_DEFLATE_LEVEL);
+}
+
+std::vector<uint8_t> encodePackedPNG(const std::vector<uint8_t>& bits, const uint32_t width, const uint32_t height) {
+    if (width == 0 || height == 0) throw std::runtime_error("Invalid image size");
+    const size_t packed_size = static_cast<size_t>((width + 7) / 8) * height;
+
+    std::vector<uint8_t> raw;
+    if (bits.size() >= packed_size) {
+        raw = scanlines(bits, width, {0, 0, width, height});
+    } else {
+        std::vector<uint8_t> padded(bits);
+        padded.resize(packed_size, 0);
+        raw = scanlines(padded, width, {0, 0, width, height});
+    }
+
+    std::vector<uint8_t> png;
+    appendHeader(png, width, height);
+    appendChunk(png, "IDAT", deflate(raw));
+    appendChunk(png, "IEND", {});
+    return png;
+}
+
+std::vector<uint8_t> encodeAnimatedPNG(const std::vector<std::vector<uint8_t>>& frames, const uint32_t width, const uint32_t height,
+                                       const uint32_t frame_rate) {
+    if (frames.empty()) throw std::runtime_error("Animation has no frames");
+    if (width == 0 || height == 0) throw std::runtime_error("Invalid animation size");
+    const size_t packed_size = static_cast<size_t>((width + 7) / 8) * height;
+    for (const auto& frame : frames) {
+        if (frame.size() < packed_size) throw std::runtime_error("Frame is smaller than the animation size");
+    }
+
+    // Identical consecutive frames become one frame shown for several ticks.
+    struct Output {
+        size_t frame;
+        Rect rect;
+        uint16_t ticks;
+    };
+    std::vector<Output> outputs{{0, {0, 0, width, height}, 1}};
+    for (size_t i = 1; i < frames.size(); ++i) {
+        const Rect rect = changedRect(frames[i - 1], frames[i], width, height);
+        if (rect.width == 0 && outputs.back().ticks < UINT16_MAX) ++outputs.back().ticks;
+        else outputs.push_back({i, rect.width ? rect : Rect{0, 0, width, height}, 1});
+    }
+
+    std::vector<uint8_t> png;
+    appendHeader(png, width, height);
+
+    std::vector<uint8_t> actl;
+    appendU32(actl, static_cast<uint32_t>(outputs.size()));
+    appendU32(actl, 0); // loop forever
+    appendChunk(png, "acTL", actl);
+
+    const auto delay_den = static_cast<uint16_t>(std::clamp<uint32_t>(frame_rate, 1, UINT16_MAX));
+    uint32_t sequence = 0;
+    for (const auto& output : outputs) {
+        appendChunk(png, "fcTL", frameControl(sequence++, output.rect, output.ticks, delay_den));
+        const auto raw = scanlines(frames[output.frame], width, output.rect);
+        const auto compressed = deflate(raw);
+        if (output.frame == 0) {
+            appendChunk(png, "IDAT", compressed);
+        } else {
+            std::vector<uint8_t> fdat;
+            appendU32(fdat, sequence++);
+            fdat.insert(fdat.end(), compressed.begin(), compressed.end());
+            appendChunk(png, "fdAT", fdat);
+        }
+    }
+
+    appendChunk(png, "IEND", {});
+    return png;
+}
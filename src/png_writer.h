@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// PNG output written directly from packed BMX bits (rows padded to whole
+// bytes, LSB-first, set bit = black). Images are stored as 1-bit palette PNGs,
+// so there is no 8-bit expansion and the data to deflate is 8x smaller than
+// with stbi_write_png.
+
+// Deflate level for every PNG the library writes (these functions and
+// encodePNG), 0..9; see deflate.h. 1 is a fast run-length-only mode for previews.
+void setPngCompressionLevel(int level);
+
+// Still 1-bit PNG. Input shorter than the image is padded with white, like
+// expandBitData does.
+std::vector<uint8_t> encodePackedPNG(const std::vector<uint8_t>& bits, uint32_t width, uint32_t height);
+
+// Animated PNG of equally sized frames shown at frame_rate. Frames after the
+// first only store the byte-aligned rectangle that changed, and runs of
+// identical frames are merged into one longer frame.
+std::vector<uint8_t> encodeAnimatedPNG(const std::vector<std::vector<uint8_t>>& frames, uint32_t width, uint32_t height,
+                                       uint32_t frame_rate);
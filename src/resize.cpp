@@ -0,0 +1,233 @@
+#include "resize.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+
+namespace {
+    constexpr double LANCZOS_A = 3.0;
+    // Weights are fixed point with 14 fraction bits. Horizontally resampled
+    // rows keep 7 fraction bits for the vertical pass, whose sums then stay
+    // well inside int32 even with Lanczos' negative lobes.
+    constexpr int WEIGHT_BITS = 14;
+    constexpr int ROW_FRACTION_BITS = 7;
+    constexpr int OUTPUT_SHIFT = WEIGHT_BITS + ROW_FRACTION_BITS;
+
+    double lanczos(const double x) {
+        if (x == 0) return 1;
+        if (std::abs(x) >= LANCZOS_A) return 0;
+        const double px = std::numbers::pi * x;
+        return LANCZOS_A * std::sin(px) * std::sin(px / LANCZOS_A) / (px * px);
+    }
+
+    // Output coordinate o reads `count` source samples from first[o] on. The
+    // count is the same for every o (short windows are zero-padded), so the
+    // inner loops have a fixed trip count.
+    struct Taps {
+        uint32_t count = 0;
+        std::vector<uint32_t> first;
+        std::vector<int32_t> weights; // count per output coordinate
+    };
+
+    Taps lanczosTaps(const uint32_t in, const uint32_t out) {
+        const double scale = static_cast<double>(in) / out;
+        // Shrinking widens the kernel by the scale so it also low-passes.
+        const double stretch = std::max(1.0, scale);
+        const double radius = LANCZOS_A * stretch;
+
+        Taps taps;
+        taps.count = std::min(in, static_cast<uint32_t>(std::ceil(radius)) * 2 + 1);
+        taps.first.resize(out);
+        taps.weights.resize(static_cast<size_t>(out) * taps.count);
+        std::vector<double> weights(taps.count);
+        for (uint32_t o = 0; o < out; ++o) {
+            const double center = (o + 0.5) * scale - 0.5;
+            const auto lo = static_cast<int64_t>(std::floor(center - radius)) + 1;
+            const auto hi = static_cast<int64_t>(std::floor(center + radius));
+            const auto first = static_cast<uint32_t>(std::clamp<int64_t>(lo, 0, in - taps.count));
+            taps.first[o] = first;
+
+            // Samples past the edges repeat the edge pixel, so their weight
+            // folds onto it.
+            std::fill(weights.begin(), weights.end(), 0.0);
+            double sum = 0;
+            for (int64_t i = lo; i <= hi; ++i) {
+                const double weight = lanczos((static_cast<double>(i) - center) / stretch);
+                weights[std::clamp<int64_t>(i, 0, in - 1) - first] += weight;
+                sum += weight;
+            }
+
+            // Rounded so the weights add up to exactly one; the rounding
+            // error goes to the largest.
+            int32_t* fixed = &taps.weights[static_cast<size_t>(o) * taps.count];
+            int32_t total = 0;
+            uint32_t largest = 0;
+            for (uint32_t k = 0; k < taps.count; ++k) {
+                fixed[k] = static_cast<int32_t>(std::lround(weights[k] / sum * (1 << WEIGHT_BITS)));
+                total += fixed[k];
+                if (std::abs(weights[k]) > std::abs(weights[largest])) largest = k;
+            }
+            fixed[largest] += (1 << WEIGHT_BITS) - total;
+        }
+        return taps;
+    }
+
+    // Source row y as gray: gray sources are read in place, others go
+    // through a one-row luma buffer.
+    class SourceRows {
+    public:
+        SourceRows(const uint8_t* pixels, const uint32_t width, const int channels, const uint8_t background)
+            : pixels(pixels), width(width), channels(channels), background(background), luma(channels == 1 ? 0 : width) {}
+
+        const uint8_t* row(const uint32_t y) {
+            const uint8_t* source = pixels + static_cast<size_t>(y) * width * channels;
+            if (channels == 1) return source;
+            convertToLuma(source, width, channels, background, luma.data());
+            return luma.data();
+        }
+
+    private:
+        const uint8_t* pixels;
+        uint32_t width;
+        int channels;
+        uint8_t background;
+        std::vector<uint8_t> luma;
+    };
+
+    void resampleRow(const uint8_t* row, const Taps& taps, int32_t* out) {
+        const uint32_t count = taps.count;
+        for (size_t o = 0; o < taps.first.size(); ++o) {
+            const uint8_t* src = row + taps.first[o];
+            const int32_t* weights = &taps.weights[o * count];
+            int32_t sum = 0;
+            for (uint32_t k = 0; k < count; ++k) sum += weights[k] * src[k];
+            out[o] = (sum + (1 << (WEIGHT_BITS - ROW_FRACTION_BITS - 1))) >> (WEIGHT_BITS - ROW_FRACTION_BITS);
+        }
+    }
+
+    void lanczosRows(SourceRows& source, const uint32_t width, const uint32_t height, const uint32_t out_width, const uint32_t out_height,
+                     const std::function<void(uint32_t, const uint8_t*)>& emit) {
+        const Taps horizontal = lanczosTaps(width, out_width);
+        const Taps vertical = lanczosTaps(height, out_height);
+
+        // Source rows already resampled horizontally, in a ring of as many
+        // rows as one output row reads. Windows only move down, so each
+        // source row is resampled once.
+        const uint32_t ring = vertical.count;
+        std::vector<int32_t> rows(static_cast<size_t>(ring) * out_width);
+        std::vector<int64_t> cached(ring, -1);
+        std::vector<int32_t> sum(out_width);
+        std::vector<uint8_t> out(out_width);
+
+        for (uint32_t oy = 0; oy < out_height; ++oy) {
+            std::fill(sum.begin(), sum.end(), 0);
+            const int32_t* weights = &vertical.weights[static_cast<size_t>(oy) * ring];
+            for (uint32_t k = 0; k < ring; ++k) {
+                const uint32_t sy = vertical.first[oy] + k;
+                int32_t* row = &rows[static_cast<size_t>(sy % ring) * out_width];
+                if (cached[sy % ring] != sy) {
+                    resampleRow(source.row(sy), horizontal, row);
+                    cached[sy % ring] = sy;
+                }
+                const int32_t weight = weights[k];
+                if (weight == 0) continue;
+                for (uint32_t x = 0; x < out_width; ++x) sum[x] += weight * row[x];
+            }
+            for (uint32_t x = 0; x < out_width; ++x)
+                out[x] = static_cast<uint8_t>(std::clamp((sum[x] + (1 << (OUTPUT_SHIFT - 1))) >> OUTPUT_SHIFT, 0, 255));
+            emit(oy, out.data());
+        }
+    }
+
+    // Column sums over the block's rows first (contiguous adds the compiler
+    // vectorizes), then each output pixel folds fx of them.
+    void areaRows(SourceRows& source, const uint32_t width, const uint32_t height, const uint32_t out_width, const uint32_t out_height,
+                  const std::function<void(uint32_t, const uint8_t*)>& emit) {
+        const uint32_t fx = width / out_width, fy = height / out_height;
+        const uint32_t cells = fx * fy;
+        std::vector<uint32_t> columns(width);
+        std::vector<uint8_t> out(out_width);
+        for (uint32_t oy = 0; oy < out_height; ++oy) {
+            std::fill(columns.begin(), columns.end(), 0u);
+            for (uint32_t sy = oy * fy; sy < (oy + 1) * fy; ++sy) {
+                const uint8_t* row = source.row(sy);
+                for (uint32_t x = 0; x < width; ++x) columns[x] += row[x];
+            }
+            for (uint32_t ox = 0; ox < out_width; ++ox) {
+                uint32_t total = 0;
+                for (uint32_t k = 0; k < fx; ++k) total += columns[ox * fx + k];
+                out[ox] = static_cast<uint8_t>((total + cells / 2) / cells);
+            }
+            emit(oy, out.data());
+        }
+    }
+}
+
+ResizeFilter parseResizeFilter(const std::string& name) {
+    for (const ResizeFilter filter : {ResizeFilter::Auto, ResizeFilter::Area, ResizeFilter::Lanczos}) {
+        if (name == resizeFilterName(filter)) return filter;
+    }
+    throw std::runtime_error("Unknown resize filter: " + name);
+}
+
+const char* resizeFilterName(const ResizeFilter filter) {
+    switch (filter) {
+        case ResizeFilter::Auto: return "auto";
+        case ResizeFilter::Area: return "area";
+        case ResizeFilter::Lanczos: return "lanczos";
+    }
+    return "unknown";
+}
+
+ResizeTarget parseResizeTarget(const std::string& text) {
+    const size_t x = text.find('x');
+    const auto isNumber = [](const std::string& s) {
+        return !s.empty() && s.size() <= 9 && std::all_of(s.begin(), s.end(), [](const char c) { return c >= '0' && c <= '9'; });
+    };
+    if (x == std::string::npos || !isNumber(text.substr(0, x)) || !isNumber(text.substr(x + 1)))
+        throw std::runtime_error("Invalid size (expected WxH): " + text);
+    return {static_cast<uint32_t>(std::stoul(text.substr(0, x))), static_cast<uint32_t>(std::stoul(text.substr(x + 1)))};
+}
+
+ResizeTarget resolveTarget(ResizeTarget target, const uint32_t width, const uint32_t height) {
+    if (target.width == 0 && target.height == 0) return {width, height};
+    const auto scaled = [](const uint32_t value, const uint32_t num, const uint32_t den) {
+        return static_cast<uint32_t>(std::max<int64_t>(1, std::llround(static_cast<double>(value) * num / den)));
+    };
+    if (target.width == 0) target.width = scaled(target.height, width, height);
+    if (target.height == 0) target.height = scaled(target.width, height, width);
+    return target;
+}
+
+void resizeRows(const uint8_t* pixels, const uint32_t width, const uint32_t height, const uint32_t out_width, const uint32_t out_height,
+                ResizeFilter filter, const std::function<void(uint32_t y, const uint8_t* row)>& emit, const int channels,
+                const uint8_t background) {
+    TraceScope trace("resize");
+    if (width == 0 || height == 0 || out_width == 0 || out_height == 0) throw std::runtime_error("Cannot resize an empty image");
+    if (channels < 1 || channels > 4) throw std::runtime_error("Unsupported channel count: " + std::to_string(channels));
+    SourceRows source(pixels, width, channels, background);
+    if (out_width == width && out_height == height) {
+        for (uint32_t y = 0; y < height; ++y) emit(y, source.row(y));
+        return;
+    }
+
+    const bool whole_blocks = out_width <= width && out_height <= height && width % out_width == 0 && height % out_height == 0;
+    if (filter == ResizeFilter::Auto) filter = whole_blocks ? ResizeFilter::Area : ResizeFilter::Lanczos;
+    if (filter == ResizeFilter::Area && !whole_blocks) {
+        throw std::runtime_error("Area resize needs the source to be a whole multiple of the target: " + std::to_string(width) + "x" +
+                                 std::to_string(height) + " to " + std::to_string(out_width) + "x" + std::to_string(out_height));
+    }
+    if (filter == ResizeFilter::Area) areaRows(source, width, height, out_width, out_height, emit);
+    else lanczosRows(source, width, height, out_width, out_height, emit);
+}
+
+std::vector<uint8_t> resizeGray(const uint8_t* pixels, const uint32_t width, const uint32_t height, const uint32_t out_width,
+                                const uint32_t out_height, const ResizeFilter filter, const int channels, const uint8_t background) {
+    std::vector<uint8_t> resized(static_cast<size_t>(out_width) * out_height);
+    resizeRows(pixels, width, height, out_width, out_height, filter, [&](const uint32_t y, const uint8_t* row) {
+        std::copy(row, row + out_width, resized.begin() + static_cast<std::ptrdiff_t>(y) * out_width);
+    }, channels, background);
+    return resized;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "luma.h"
+
+// Area averages whole fx * fy source blocks, so it needs the source to be an
+// integer multiple of the target; Lanczos (a = 3, widened when shrinking)
+// takes any ratio, up or down. Auto uses Area whenever it applies.
+enum class ResizeFilter {
+    Auto,
+    Area,
+    Lanczos,
+};
+
+// "auto", "area" or "lanczos"; throws on anything else.
+ResizeFilter parseResizeFilter(const std::string& name);
+const char* resizeFilterName(ResizeFilter filter);
+
+// A zero dimension follows the source aspect ratio; 0x0 keeps the source size.
+struct ResizeTarget {
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+// "WxH", e.g. "128x64" or "128x0"; throws on anything else.
+ResizeTarget parseResizeTarget(const std::string& text);
+// The target with zero dimensions filled in from a width x height source.
+ResizeTarget resolveTarget(ResizeTarget target, uint32_t width, uint32_t height);
+
+// Resamples to 8-bit gray, separably and in fixed point. Output rows come out
+// top to bottom and go to emit(y, row) as soon as they are complete; only the
+// horizontally resampled source rows the current output row needs are kept,
+// so a consumer that packs each row never holds the resized image. Sources
+// with more than one channel (see luma.h) are converted to gray a row at a
+// time as the horizontal pass reads them.
+void resizeRows(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t out_width, uint32_t out_height,
+                ResizeFilter filter, const std::function<void(uint32_t y, const uint8_t* row)>& emit,
+                int channels = 1, uint8_t background = DEFAULT_BACKGROUND);
+std::vector<uint8_t> resizeGray(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t out_width, uint32_t out_height,
+                                ResizeFilter filter, int channels = 1, uint8_t background = DEFAULT_BACKGROUND);
@@ -0,0 +1,121 @@
+#include "trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+    struct TraceEvent {
+        const char* name;
+        std::string file;
+        int64_t start_us;
+        int64_t duration_us;
+    };
+
+    struct ThreadTraceBuffer {
+        uint32_t tid;
+        std::vector<TraceEvent> events;
+    };
+
+    std::atomic<bool> trace_enabled{false};
+
+    // Buffers are owned here so they outlive the threads that filled them.
+    std::mutex registry_mutex;
+    std::vector<std::unique_ptr<ThreadTraceBuffer>> registry;
+
+    thread_local ThreadTraceBuffer* thread_buffer = nullptr;
+    thread_local std::string thread_label;
+
+    int64_t nowMicros() {
+        static const auto epoch = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    ThreadTraceBuffer& threadBuffer() {
+        if (!thread_buffer) {
+            std::lock_guard lock(registry_mutex);
+            auto buffer = std::make_unique<ThreadTraceBuffer>();
+            buffer->tid = static_cast<uint32_t>(registry.size() + 1);
+            buffer->events.reserve(4096);
+            thread_buffer = buffer.get();
+            registry.push_back(std::move(buffer));
+        }
+        return *thread_buffer;
+    }
+
+    void writeJsonString(std::ofstream& f, const std::string& s) {
+        f << '"';
+        for (const char c : s) {
+            switch (c) {
+                case '"': f << "\\\""; break;
+                case '\\': f << "\\\\"; break;
+                case '\n': f << "\\n"; break;
+                case '\t': f << "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        constexpr char hex[] = "0123456789abcdef";
+                        f << "\\u00" << hex[(c >> 4) & 0xF] << hex[c & 0xF];
+                    } else {
+                        f << c;
+                    }
+            }
+        }
+        f << '"';
+    }
+}
+
+void setTraceEnabled(const bool enabled) {
+    if (enabled) nowMicros(); // pin the epoch before any worker starts
+    trace_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool isTraceEnabled() {
+    return trace_enabled.load(std::memory_order_relaxed);
+}
+
+bool writeTrace(const std::string& path) {
+    std::ofstream f(path);
+    if (!f) return false;
+
+    std::lock_guard lock(registry_mutex);
+    f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool first = true;
+    for (const auto& buffer : registry) {
+        if (!first) f << ",\n";
+        first = false;
+        f << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << buffer->tid
+          << R"(,"args":{"name":"worker )" << buffer->tid << "\"}}";
+
+        for (const auto& event : buffer->events) {
+            f << ",\n{\"name\":\"" << event.name << R"(","cat":"flipit","ph":"X","pid":1,"tid":)" << buffer->tid
+              << ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us << ",\"args\":{\"file\":";
+            writeJsonString(f, event.file);
+            f << "}}";
+        }
+    }
+
+    f << "\n]}\n";
+    return static_cast<bool>(f);
+}
+
+TraceLabel::TraceLabel(const std::string& file) : previous(std::move(thread_label)) {
+    thread_label = file;
+}
+
+TraceLabel::~TraceLabel() {
+    thread_label = std::move(previous);
+}
+
+TraceScope::TraceScope(const char* name) : name(name) {
+    if (isTraceEnabled()) start_us = nowMicros();
+}
+
+TraceScope::~TraceScope() {
+    if (start_us < 0) return;
+    const int64_t end_us = nowMicros();
+    threadBuffer().events.push_back({name, thread_label, start_us, end_us - start_us});
+}
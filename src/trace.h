@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Chrome/Perfetto trace-event recording for conversion runs. Every thread
+// appends spans to its own buffer, so recording never takes a lock; the
+// buffers are only merged when writeTrace() is called after the work is done.
+void setTraceEnabled(bool enabled);
+bool isTraceEnabled();
+
+// Writes all recorded spans as trace-event JSON (load in ui.perfetto.dev or
+// chrome://tracing). Must not run concurrently with recording threads.
+bool writeTrace(const std::string& path);
+
+// Tags every span recorded on the current thread with a file name until it
+// goes out of scope.
+class TraceLabel {
+public:
+    explicit TraceLabel(const std::string& file);
+    ~TraceLabel();
+
+    TraceLabel(const TraceLabel&) = delete;
+    TraceLabel& operator=(const TraceLabel&) = delete;
+
+private:
+    std::string previous;
+};
+
+// Records a complete ("X") span covering the lifetime of the object.
+class TraceScope {
+public:
+    explicit TraceScope(const char* name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    int64_t start_us = -1;
+};
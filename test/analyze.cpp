@@ -0,0 +1,118 @@
+#include "commands.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bm_analyze.h"
+
+namespace {
+    struct AnalyzedFile {
+        std::string path;
+        size_t raw_size;
+        HeatshrinkStats stats;
+        DecodeCost cost;
+    };
+
+    void printHistogramRow(const std::string& label, const size_t count, const size_t total) {
+        constexpr int BAR_WIDTH = 40;
+        const int bar = total ? static_cast<int>(count * BAR_WIDTH / total) : 0;
+        std::cout << "    " << std::left << std::setw(10) << label << std::right << std::setw(8) << count << "  "
+                  << std::string(bar, '#') << "\n";
+    }
+
+    void printReport(const AnalyzedFile& file) {
+        const auto& s = file.stats;
+        const size_t tokens = s.literal_count + s.backref_count;
+        const size_t total_bits = s.literal_bits + s.backref_bits + s.padding_bits;
+
+        std::cout << file.path << "\n"
+                  << "  stream: " << s.input_bytes << " bytes -> " << s.output_bytes << " bytes (window "
+                  << +s.window_bits << ", lookahead " << +s.lookahead_bits << ")\n"
+                  << std::fixed << std::setprecision(1)
+                  << "  literals:  " << std::setw(6) << s.literal_count << " tokens, " << std::setw(7) << s.literal_bits
+                  << " bits (" << (total_bits ? 100.0 * s.literal_bits / total_bits : 0.0) << "%)\n"
+                  << "  backrefs:  " << std::setw(6) << s.backref_count << " tokens, " << std::setw(7) << s.backref_bits
+                  << " bits (" << (total_bits ? 100.0 * s.backref_bits / total_bits : 0.0) << "%), "
+                  << s.backref_bytes << " bytes copied\n"
+                  << "  padding:   " << s.padding_bits << " bits\n"
+                  << "  longest literal run: " << s.longest_literal_run << ", refs into zeroed window: " << s.prestart_refs << "\n";
+        if (tokens)
+            std::cout << "  bits per output byte: " << std::setprecision(2)
+                      << static_cast<double>(s.literal_bits + s.backref_bits) / s.output_bytes << "\n";
+
+        std::cout << "  length histogram:\n";
+        for (size_t n = 1; n < s.length_histogram.size(); ++n)
+            if (s.length_histogram[n]) printHistogramRow(std::to_string(n), s.length_histogram[n], s.backref_count);
+
+        std::cout << "  distance histogram:\n";
+        for (size_t lo = 1; lo < s.distance_histogram.size(); lo *= 2) {
+            const size_t hi = std::min(lo * 2 - 1, s.distance_histogram.size() - 1);
+            size_t count = 0;
+            for (size_t d = lo; d <= hi; ++d) count += s.distance_histogram[d];
+            const std::string label = lo == hi ? std::to_string(lo) : std::to_string(lo) + "-" + std::to_string(hi);
+            printHistogramRow(label, count, s.backref_count);
+        }
+
+        std::cout << "  decode cost: " << file.cost.bits_read << " bits read, " << file.cost.tokens << " tokens, "
+                  << file.cost.bytes_written << " bytes written, ~" << file.cost.cycles << " cycles ("
+                  << std::setprecision(1) << file.cost.micros << " us at " << DEVICE_CPU_HZ / 1000000 << " MHz)\n";
+    }
+
+    void collectInputs(const std::filesystem::path& path, std::vector<std::string>& inputs) {
+        if (!std::filesystem::is_directory(path)) {
+            inputs.push_back(path.string());
+            return;
+        }
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+            const auto ext = entry.path().extension();
+            if (entry.is_regular_file() && (ext == ".bmx" || ext == ".bm"))
+                inputs.push_back(entry.path().string());
+        }
+    }
+}
+
+int runAnalyze(const int argc, char** argv) {
+    std::vector<std::string> inputs;
+    for (int i = 2; i < argc; ++i) collectInputs(argv[i], inputs);
+    std::sort(inputs.begin(), inputs.end());
+
+    std::vector<AnalyzedFile> results;
+    for (const auto& path : inputs) {
+        size_t raw_size = 0;
+        const auto stream = readHeatshrinkStream(path, raw_size);
+        if (stream.empty()) {
+            std::cout << path << ": stored uncompressed (" << raw_size << " bytes), nothing to analyze\n";
+            continue;
+        }
+
+        AnalyzedFile file{path, raw_size, analyzeHeatshrink(stream.data(), stream.size()), {}};
+        file.cost = estimateDecodeCost(file.stats);
+        if (raw_size && file.stats.output_bytes != raw_size)
+            std::cerr << "Warning: " << path << " decodes to " << file.stats.output_bytes << " bytes, expected " << raw_size << "\n";
+        results.push_back(std::move(file));
+    }
+
+    if (results.size() == 1) {
+        printReport(results.front());
+        return 0;
+    }
+
+    // Several files: rank them by estimated decode cost, most expensive first.
+    std::sort(results.begin(), results.end(), [](const AnalyzedFile& a, const AnalyzedFile& b) {
+        return a.cost.cycles > b.cost.cycles;
+    });
+
+    std::cout << std::setw(10) << "cycles" << std::setw(10) << "us" << std::setw(8) << "in" << std::setw(8) << "out"
+              << std::setw(8) << "lits" << std::setw(8) << "refs" << "  file\n";
+    for (const auto& file : results) {
+        std::cout << std::setw(10) << file.cost.cycles << std::setw(10) << std::fixed << std::setprecision(1) << file.cost.micros
+                  << std::setw(8) << file.stats.input_bytes << std::setw(8) << file.stats.output_bytes
+                  << std::setw(8) << file.stats.literal_count << std::setw(8) << file.stats.backref_count
+                  << "  " << file.path << "\n";
+    }
+    return 0;
+}
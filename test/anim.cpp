@@ -0,0 +1,277 @@
+#include "commands.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bm_utils.h"
+#include "png_writer.h"
+#include "thread_pool.h"
+
+namespace {
+    std::string frameName(const uint32_t index) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%02u.bm", index);
+        return name;
+    }
+
+    void writeMeta(const std::filesystem::path& output_dir, const BmMeta& meta) {
+        const std::string meta_path = (output_dir / "meta").string();
+        if (!writeBmMeta(meta_path, meta)) throw std::runtime_error("Failed to write " + meta_path);
+    }
+
+    // BmMeta has a single rate, so variable GIF delays are averaged. Delays of
+    // 0 or 10 ms are shown as 100 ms by browsers, so they count as that here.
+    uint32_t frameRateFromDelays(const std::vector<int>& delays_ms) {
+        if (delays_ms.empty()) return 10;
+        double total = 0;
+        for (const int delay : delays_ms) total += delay <= 10 ? 100 : delay;
+        return std::max(1u, static_cast<uint32_t>(std::lround(1000.0 * delays_ms.size() / total)));
+    }
+}
+
+int runGif2Anim(const int argc, char** argv) {
+    if (argc < 4) {
+        std::cerr << "Usage: tool gif2anim <input.gif> <output_dir> [--fps N] [--jobs N] [--dither MODE] [--threshold N|auto]\n"
+                  << "       [--background 0-255] [--resize WxH] [--resize-filter F]\n";
+        return 1;
+    }
+
+    const std::string input_file = argv[2];
+    const std::filesystem::path output_dir = argv[3];
+    uint32_t fps_override = 0;
+    size_t jobs = 0;
+    ConvertOptions options;
+    for (int i = 4; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--fps" && i + 1 < argc) fps_override = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (arg == "--jobs" && i + 1 < argc) jobs = std::stoul(argv[++i]);
+        else if (parseConvertOption(argc, argv, i, options)) continue;
+        else {
+            std::cerr << "Unknown gif2anim option: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // GIF frames are deltas on the previous canvas, so decoding is sequential;
+    // threshold, compression and writing are per frame and run in parallel.
+    uint32_t width = 0, height = 0;
+    std::vector<int> delays_ms;
+    const auto pixels = decodeGifFrames(readFile(input_file), width, height, delays_ms, options.background);
+    const auto frame_count = static_cast<uint32_t>(delays_ms.size());
+    const size_t frame_pixels = static_cast<size_t>(width) * height;
+    const ResizeTarget size = outputSize(options, width, height);
+
+    std::filesystem::create_directories(output_dir);
+    ThreadPool pool(jobs);
+    parallelFor(pool, frame_count, [&](const size_t i) {
+        const std::string path = (output_dir / frameName(static_cast<uint32_t>(i))).string();
+        if (!writeBM(path, pixels.data() + i * frame_pixels, width, height, options)) throw std::runtime_error("Failed to write " + path);
+    });
+
+    BmMeta meta{};
+    meta.width = size.width;
+    meta.height = size.height;
+    meta.frame_rate = fps_override ? fps_override : frameRateFromDelays(delays_ms);
+    meta.frame_count = frame_count;
+    writeMeta(output_dir, meta);
+
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Converted " << frame_count << " frames (" << meta.width << "x" << meta.height << " @ " << meta.frame_rate
+              << " fps) in " << elapsed << " ms using " << pool.size() << " threads\n";
+
+    if (std::adjacent_find(delays_ms.begin(), delays_ms.end(), std::not_equal_to<>()) != delays_ms.end())
+        std::cout << "Note: GIF frame delays vary; meta uses their average rate\n";
+    return 0;
+}
+
+int runPng2Bm(const int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: tool png2bm <input.png> [output.bm] [--dither MODE] [--threshold N|auto] [--background 0-255]\n"
+                  << "       [--resize WxH] [--resize-filter F]\n"
+                  << "       tool png2bm <input_dir> <output_dir> [--fps N] [--jobs N] [--dither MODE] [--threshold N|auto]\n"
+                  << "       [--background 0-255] [--resize WxH] [--resize-filter F]\n";
+        return 1;
+    }
+
+    const std::filesystem::path input = argv[2];
+    ConvertOptions options;
+    if (!std::filesystem::is_directory(input)) {
+        const bool has_output = argc > 3 && std::string(argv[3]).rfind("--", 0) != 0;
+        const std::string output_file = has_output ? argv[3] : input.stem().string() + ".bm";
+        for (int i = has_output ? 4 : 3; i < argc; ++i) {
+            if (!parseConvertOption(argc, argv, i, options)) {
+                std::cerr << "Unknown png2bm option: " << argv[i] << "\n";
+                return 1;
+            }
+        }
+        uint32_t width, height;
+        const auto bits = decodeImageBits(readFile(input.string()), width, height, options);
+        if (!writeFile(output_file, encodeBM(bits))) throw std::runtime_error("Failed to write " + output_file);
+        std::cout << "Converted PNG to BM: " << output_file << "\n";
+        return 0;
+    }
+
+    if (argc < 4) {
+        std::cerr << "png2bm on a directory needs an output directory\n";
+        return 1;
+    }
+    const std::filesystem::path output_dir = argv[3];
+    uint32_t frame_rate = 10;
+    size_t jobs = 0;
+    for (int i = 4; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--fps" && i + 1 < argc) frame_rate = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (arg == "--jobs" && i + 1 < argc) jobs = std::stoul(argv[++i]);
+        else if (parseConvertOption(argc, argv, i, options)) continue;
+        else {
+            std::cerr << "Unknown png2bm option: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    // Frames are numbered in file name order.
+    std::vector<std::filesystem::path> inputs;
+    for (const auto& entry : std::filesystem::directory_iterator(input)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".png") inputs.push_back(entry.path());
+    }
+    std::sort(inputs.begin(), inputs.end());
+    if (inputs.empty()) {
+        std::cerr << "No .png files in " << input.string() << "\n";
+        return 1;
+    }
+
+    // Every frame is converted and size-checked before anything is written,
+    // so a mismatched frame leaves the output directory untouched.
+    const auto start = std::chrono::steady_clock::now();
+    ThreadPool pool(jobs);
+    std::vector<std::pair<uint32_t, uint32_t>> sizes(inputs.size());
+    std::vector<std::vector<uint8_t>> frames(inputs.size());
+    parallelFor(pool, inputs.size(), [&](const size_t i) {
+        auto& [width, height] = sizes[i];
+        frames[i] = encodeBM(decodeImageBits(readFile(inputs[i].string()), width, height, options));
+    });
+
+    for (size_t i = 1; i < sizes.size(); ++i) {
+        if (sizes[i] != sizes[0])
+            throw std::runtime_error(inputs[i].filename().string() + " does not match the size of " + inputs[0].filename().string());
+    }
+
+    std::filesystem::create_directories(output_dir);
+    for (size_t i = 0; i < frames.size(); ++i) {
+        const std::string path = (output_dir / frameName(static_cast<uint32_t>(i))).string();
+        if (!writeFile(path, frames[i])) throw std::runtime_error("Failed to write " + path);
+    }
+
+    BmMeta meta{};
+    meta.width = sizes[0].first;
+    meta.height = sizes[0].second;
+    meta.frame_rate = frame_rate;
+    meta.frame_count = static_cast<uint32_t>(inputs.size());
+    writeMeta(output_dir, meta);
+
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Converted " << inputs.size() << " frames (" << meta.width << "x" << meta.height << " @ " << frame_rate
+              << " fps) in " << elapsed << " ms using " << pool.size() << " threads\n";
+    return 0;
+}
+
+int runAnim2Apng(const int argc, char** argv) {
+    std::vector<std::filesystem::path> anim_dirs;
+    std::string output_file;
+    std::filesystem::path output_dir;
+    size_t jobs = 0;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) output_file = argv[++i];
+        else if (arg == "--output-dir" && i + 1 < argc) output_dir = argv[++i];
+        else if (arg == "--png-level" && i + 1 < argc) setPngCompressionLevel(std::stoi(argv[++i]));
+        else if (arg == "--jobs" && i + 1 < argc) jobs = std::stoul(argv[++i]);
+        else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Unknown anim2apng option: " << arg << "\n";
+            return 1;
+        } else anim_dirs.emplace_back(arg);
+    }
+    if (anim_dirs.empty() || (!output_file.empty() && anim_dirs.size() > 1)) {
+        std::cerr << "Usage: tool anim2apng <anim_dir>... [-o output.png | --output-dir DIR] [--jobs N] [--png-level 0-9]\n";
+        return 1;
+    }
+
+    struct Animation {
+        std::filesystem::path dir;
+        std::string output;
+        BmMeta meta{};
+        std::vector<std::vector<uint8_t>> frames;
+        std::string error;
+    };
+    std::vector<Animation> animations(anim_dirs.size());
+    std::vector<std::pair<size_t, uint32_t>> frame_jobs;
+    for (size_t a = 0; a < anim_dirs.size(); ++a) {
+        auto& anim = animations[a];
+        anim.dir = anim_dirs[a];
+        auto normalized = std::filesystem::absolute(anim.dir).lexically_normal();
+        if (!normalized.has_filename()) normalized = normalized.parent_path(); // trailing slash
+        const std::string name = normalized.filename().string();
+        anim.output = !output_file.empty() ? output_file : (output_dir / (name + ".png")).string();
+        try {
+            anim.meta = readBmMeta((anim.dir / "meta").string());
+        } catch (const std::exception& e) {
+            anim.error = e.what();
+            continue;
+        }
+        anim.frames.resize(anim.meta.frame_count);
+        for (uint32_t f = 0; f < anim.meta.frame_count; ++f) frame_jobs.emplace_back(a, f);
+    }
+    if (!output_dir.empty()) std::filesystem::create_directories(output_dir);
+
+    const auto start = std::chrono::steady_clock::now();
+    ThreadPool pool(jobs);
+
+    // Frames of every animation are decoded in one parallel pass, then each
+    // animation is encoded as a unit.
+    std::vector<std::string> frame_errors(frame_jobs.size());
+    parallelFor(pool, frame_jobs.size(), [&](const size_t i) {
+        const auto [a, f] = frame_jobs[i];
+        try {
+            animations[a].frames[f] = decodeBM(readFile((animations[a].dir / frameName(f)).string()));
+        } catch (const std::exception& e) {
+            frame_errors[i] = frameName(f) + ": " + e.what();
+        }
+    });
+    for (size_t i = 0; i < frame_jobs.size(); ++i) {
+        auto& anim = animations[frame_jobs[i].first];
+        if (!frame_errors[i].empty() && anim.error.empty()) anim.error = frame_errors[i];
+    }
+
+    parallelFor(pool, animations.size(), [&](const size_t a) {
+        auto& anim = animations[a];
+        if (!anim.error.empty()) return;
+        try {
+            const auto png = encodeAnimatedPNG(anim.frames, anim.meta.width, anim.meta.height, anim.meta.frame_rate);
+            if (!writeFile(anim.output, png)) throw std::runtime_error("Failed to write " + anim.output);
+        } catch (const std::exception& e) {
+            anim.error = e.what();
+        }
+    });
+
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    size_t failed = 0;
+    for (const auto& anim : animations) {
+        if (anim.error.empty()) continue;
+        std::cerr << "Failed: " << anim.dir.string() << ": " << anim.error << "\n";
+        ++failed;
+    }
+    if (animations.size() == 1 && failed == 0) std::cout << "Saved APNG as " << animations[0].output << "\n";
+    std::cout << "Exported " << animations.size() - failed << "/" << animations.size() << " animations (" << frame_jobs.size()
+              << " frames) in " << elapsed << " ms using " << pool.size() << " threads\n";
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+#include "commands.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bm_constexpr.h"
+#include "bm_utils.h"
+#include "deflate.h"
+#include "embedded_assets.h"
+#include "pbm.h"
+#include "perf_counters.h"
+#include "png_writer.h"
+#include "stb_image.h"
+
+namespace {
+    struct Benchmark {
+        std::string name;
+        std::string unit;   // what the counters are normalized by
+        size_t units;       // units processed per iteration
+        std::function<size_t()> run;
+    };
+
+    volatile size_t bench_sink = 0;
+
+    // Decoded by the compiler; runCheck compares it with the runtime decoder.
+    constexpr BmxInfo UPDATING_INFO = parseBmxHeader(UPDATING_BMX);
+    static_assert(UPDATING_INFO.width == 32 && UPDATING_INFO.height == 40 && UPDATING_INFO.is_compressed);
+    const auto UPDATING_BITS = decodeBmxConsteval<bmxPackedSize(UPDATING_BMX)>(UPDATING_BMX);
+
+    void printCounter(const PerfCounterValues& counters, const PerfCounter counter, const double per) {
+        if (!counters.has(counter)) return;
+        std::cout << "    " << std::left << std::setw(14) << perfCounterName(counter) << std::right
+                  << std::setw(14) << counters.get(counter) / per << "\n";
+    }
+
+    void runBenchmark(const Benchmark& bench, const size_t iterations, PerfCounters* perf) {
+        bench_sink = bench_sink + bench.run(); // warm-up
+
+        if (perf) perf->start();
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+            bench_sink = bench_sink + bench.run();
+        const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        const PerfCounterValues counters = perf ? perf->stop() : PerfCounterValues{};
+
+        const double per_iter = elapsed / static_cast<double>(iterations);
+        const double total_units = static_cast<double>(bench.units) * static_cast<double>(iterations);
+
+        std::cout << std::left << std::setw(22) << bench.name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << per_iter / 1000.0 << " us/iter"
+                  << std::setw(10) << elapsed / total_units << " ns/" << bench.unit << "\n";
+
+        if (!perf) return;
+        std::cout << "    per " << bench.unit << ":\n";
+        for (size_t c = 0; c < PERF_COUNTER_COUNT; ++c)
+            printCounter(counters, static_cast<PerfCounter>(c), total_units);
+        if (counters.has(PerfCounter::Cycles) && counters.has(PerfCounter::Instructions) && counters.get(PerfCounter::Cycles) > 0) {
+            std::cout << "    " << std::left << std::setw(14) << "IPC" << std::right << std::setw(14)
+                      << static_cast<double>(counters.get(PerfCounter::Instructions)) / static_cast<double>(counters.get(PerfCounter::Cycles)) << "\n";
+        }
+    }
+}
+
+int runCheck(int, char**) {
+    // Short and exact-size inputs are where codecs read or write past the
+    // end; each one gets a heap buffer of exactly its size so a sanitizer
+    // build (FLIPIT_SANITIZE) catches the overrun.
+    const std::vector<std::pair<const char*, std::function<uint8_t(size_t)>>> patterns = {
+        {"zeros", [](size_t) { return uint8_t{0}; }},
+        {"period 7", [](const size_t i) { return static_cast<uint8_t>(i % 7); }},
+        {"period 266", [](const size_t i) { return static_cast<uint8_t>(i % 266 * 13); }},
+        {"noise", [](const size_t i) { return static_cast<uint8_t>((i * 2654435761u) >> 13); }},
+    };
+
+    size_t checked = 0, failed = 0;
+    const auto fail = [&](const std::string& what, const char* pattern, const size_t size) {
+        std::cerr << "Round trip failed: " << what << ", " << pattern << ", " << size << " bytes\n";
+        ++failed;
+    };
+    for (const auto& [name, byteAt] : patterns) {
+        for (size_t size = 0; size <= 1100; ++size) {
+            const auto input = std::make_unique<uint8_t[]>(size);
+            for (size_t i = 0; i < size; ++i) input[i] = byteAt(i);
+            const std::vector<uint8_t> expected(input.get(), input.get() + size);
+
+            for (int level = 0; level <= MAX_DEFLATE_LEVEL; ++level) {
+                const auto zlib = zlibCompress(input.get(), size, level);
+                int length = 0;
+                char* inflated = stbi_zlib_decode_malloc(reinterpret_cast<const char*>(zlib.data()), static_cast<int>(zlib.size()), &length);
+                if (!inflated || static_cast<size_t>(length) != size || !std::equal(expected.begin(), expected.end(), reinterpret_cast<uint8_t*>(inflated)))
+                    fail("zlib level " + std::to_string(level), name, size);
+                free(inflated);
+                ++checked;
+            }
+
+            const auto heatshrink = compressHeatshrink(input.get(), size);
+            if (decompressHeatshrink(heatshrink.data(), heatshrink.size()) != expected) fail("heatshrink", name, size);
+            if (decodeBM(encodeBM(expected)) != expected) fail(".bm", name, size);
+            checked += 2;
+        }
+    }
+    BmxHeader header{};
+    const auto updating = decodeBMX(std::vector<uint8_t>(std::begin(UPDATING_BMX), std::end(UPDATING_BMX)), header);
+    if (!std::equal(updating.begin(), updating.end(), UPDATING_BITS.begin(), UPDATING_BITS.end()))
+        fail("compile-time BMX decode", "Updating_32x40.bmx", sizeof(UPDATING_BMX));
+    ++checked;
+
+    std::cout << checked - failed << "/" << checked << " round trips OK\n";
+    return failed == 0 ? 0 : 1;
+}
+
+int runBench(const int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: tool bench <input.bmx> [--iterations N] [--perf]\n";
+        return 1;
+    }
+
+    const std::string input_file = argv[2];
+    size_t iterations = 1000;
+    bool use_perf = false;
+    for (int i = 3; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::stoul(argv[++i]);
+        } else if (arg == "--perf") {
+            use_perf = true;
+        } else {
+            std::cerr << "Unknown bench option: " << arg << "\n";
+            return 1;
+        }
+    }
+    if (iterations == 0) iterations = 1;
+
+    BmxHeader info{};
+    const auto bitData = LoadBMX(input_file, info);
+    const auto pixels = expandBitData(bitData, info.width, info.height);
+    const auto compressed = compressHeatshrink(bitData.data(), bitData.size());
+    const size_t pixel_count = static_cast<size_t>(info.width) * info.height;
+    // Same image as opaque RGBA, the layout most design tools export.
+    std::vector<uint8_t> rgba(pixel_count * 4, 255);
+    for (size_t i = 0; i < pixel_count; ++i) rgba[4 * i] = rgba[4 * i + 1] = rgba[4 * i + 2] = pixels[i];
+
+    std::cout << input_file << ": " << info.width << "x" << info.height << ", " << bitData.size() << " packed bytes, "
+              << compressed.size() << " compressed bytes, " << iterations << " iterations\n";
+
+    const std::vector<Benchmark> benchmarks = {
+        {"decompressHeatshrink", "byte", bitData.size(), [&] { return decompressHeatshrink(compressed.data(), compressed.size()).size(); }},
+        {"compressHeatshrink", "byte", bitData.size(), [&] { return compressHeatshrink(bitData.data(), bitData.size()).size(); }},
+        {"expandBitData", "pixel", pixel_count, [&] { return expandBitData(bitData, info.width, info.height).size(); }},
+        {"convertToBitData", "pixel", pixel_count, [&] { return convertToBitData(pixels.data(), info.width, info.height).size(); }},
+        {"ditherToBitData (bayer8)", "pixel", pixel_count, [&] { return ditherToBitData(pixels.data(), info.width, info.height, DitherMode::Bayer8).size(); }},
+        {"ditherToBitData (bluenoise)", "pixel", pixel_count, [&] { return ditherToBitData(pixels.data(), info.width, info.height, DitherMode::BlueNoise).size(); }},
+        {"ditherToBitData (floyd-steinberg)", "pixel", pixel_count, [&] { return ditherToBitData(pixels.data(), info.width, info.height, DitherMode::FloydSteinberg).size(); }},
+        {"ditherToBitData (atkinson)", "pixel", pixel_count, [&] { return ditherToBitData(pixels.data(), info.width, info.height, DitherMode::Atkinson).size(); }},
+        {"convertToBitData (RGBA)", "pixel", pixel_count, [&] { return convertToBitData(rgba.data(), info.width, info.height, 4).size(); }},
+        {"lumaHistogram", "pixel", pixel_count, [&] { return static_cast<size_t>(lumaHistogram(pixels.data(), info.width, info.height, 1)[0]); }},
+        {"convertToBitData (auto)", "pixel", pixel_count, [&] {
+            ConvertOptions options;
+            options.threshold = AUTO_THRESHOLD;
+            return convertToBitData(pixels.data(), info.width, info.height, 1, options).size();
+        }},
+        // Per source pixel; half size is an area resize for even dimensions.
+        {"convertToBitData (half size)", "pixel", pixel_count, [&] {
+            ConvertOptions options;
+            options.sizes = {{std::max(1u, info.width / 2), std::max(1u, info.height / 2)}};
+            return convertToBitData(pixels.data(), info.width, info.height, 1, options).size();
+        }},
+        {"convertToBitData (lanczos 3/4)", "pixel", pixel_count, [&] {
+            ConvertOptions options;
+            options.sizes = {{std::max(1u, info.width * 3 / 4), std::max(1u, info.height * 3 / 4)}};
+            options.resize_filter = ResizeFilter::Lanczos;
+            return convertToBitData(pixels.data(), info.width, info.height, 1, options).size();
+        }},
+        {"encodePNG (8-bit)", "pixel", pixel_count, [&] { return encodePNG(pixels, info.width, info.height).size(); }},
+        {"encodePackedPNG (1-bit)", "pixel", pixel_count, [&] { return encodePackedPNG(bitData, info.width, info.height).size(); }},
+        {"encodePBM", "pixel", pixel_count, [&] { return encodePBM(bitData, info.width, info.height).size(); }},
+    };
+
+    PerfCounters counters;
+    PerfCounters* perf = nullptr;
+    if (use_perf) {
+        if (counters.available()) perf = &counters;
+        else std::cerr << "Hardware counters unavailable (check /proc/sys/kernel/perf_event_paranoid)\n";
+    }
+
+    for (const auto& bench : benchmarks)
+        runBenchmark(bench, iterations, perf);
+
+    return 0;
+}
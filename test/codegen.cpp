@@ -0,0 +1,408 @@
+#include "commands.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bm_utils.h"
+#include "thread_pool.h"
+
+namespace {
+    struct CodegenAsset {
+        std::string name;
+        std::filesystem::path source;
+        bool is_animation = false;
+
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t frame_rate = 0;
+        std::vector<std::vector<uint8_t>> frames; // each in .bm layout
+        std::string stamp;                        // sizes and mtimes of the source files
+    };
+
+    // Enumerator the generated IconId always ends with.
+    constexpr const char* COUNT_ENUMERATOR = "Count";
+
+    std::string sanitizeIdentifier(const std::string& name) {
+        std::string id;
+        for (const char c : name)
+            id += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+        if (id.empty() || std::isdigit(static_cast<unsigned char>(id.front()))) id.insert(0, "_");
+        return id;
+    }
+
+    // Body of a C string literal; octal escapes are always three digits so a
+    // following digit cannot extend them.
+    std::string escapeCString(const std::string& text) {
+        std::string escaped;
+        for (const char c : text) {
+            const auto byte = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += c;
+            } else if (byte < 0x20 || byte >= 0x7F) {
+                escaped += '\\';
+                escaped += static_cast<char>('0' + (byte >> 6));
+                escaped += static_cast<char>('0' + (byte >> 3 & 7));
+                escaped += static_cast<char>('0' + (byte & 7));
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    size_t packedSize(const uint32_t width, const uint32_t height) {
+        return static_cast<size_t>((width + 7) / 8) * height;
+    }
+
+    // Re-wraps a BMX payload in the .bm frame layout without re-encoding it.
+    std::vector<uint8_t> bmFrameFromBmx(const std::vector<uint8_t>& file, CodegenAsset& asset) {
+        const BmxHeader header = readBmxHeader(file);
+        asset.width = header.width;
+        asset.height = header.height;
+
+        const StoredData data = locateBMXData(header, file.size());
+        if (data.is_compressed) return compressedBMFrame(file.data() + data.offset, data.size);
+
+        std::vector<uint8_t> frame{0x00};
+        frame.insert(frame.end(), file.begin() + static_cast<std::ptrdiff_t>(data.offset), file.end());
+        return frame;
+    }
+
+    // Changes whenever a source file of the asset is added, removed, resized
+    // or touched; an unchanged stamp lets the cached frames stand in for a reload.
+    std::string sourceStamp(const CodegenAsset& asset) {
+        std::vector<std::filesystem::path> files;
+        if (asset.is_animation) {
+            for (const auto& entry : std::filesystem::directory_iterator(asset.source))
+                if (entry.is_regular_file()) files.push_back(entry.path());
+            std::sort(files.begin(), files.end());
+        } else {
+            files.push_back(asset.source);
+        }
+
+        std::string stamp;
+        for (const auto& file : files) {
+            stamp += file.filename().string() + ":" + std::to_string(std::filesystem::file_size(file)) + ":"
+                   + std::to_string(std::filesystem::last_write_time(file).time_since_epoch().count()) + ";";
+        }
+        return stamp;
+    }
+
+    void loadAsset(CodegenAsset& asset) {
+        if (asset.is_animation) {
+            const BmMeta meta = readBmMeta((asset.source / "meta").string());
+            asset.width = meta.width;
+            asset.height = meta.height;
+            asset.frame_rate = meta.frame_rate;
+            for (uint32_t i = 0; i < meta.frame_count; ++i) {
+                char frame_name[32];
+                std::snprintf(frame_name, sizeof(frame_name), "frame_%02u.bm", i);
+                asset.frames.push_back(readFile((asset.source / frame_name).string()));
+            }
+        } else {
+            asset.frames.push_back(bmFrameFromBmx(readFile(asset.source.string()), asset));
+        }
+
+        // Decode once so a broken asset fails the build step rather than the device.
+        for (const auto& frame : asset.frames) {
+            if (decodeBM(frame).size() < packedSize(asset.width, asset.height))
+                throw std::runtime_error("Frame of " + asset.source.string() + " decodes to fewer bytes than its dimensions need");
+        }
+    }
+
+    std::vector<CodegenAsset> collectAssets(const std::filesystem::path& root) {
+        std::vector<CodegenAsset> assets;
+        for (auto it = std::filesystem::recursive_directory_iterator(root); it != std::filesystem::recursive_directory_iterator(); ++it) {
+            const auto& entry = *it;
+            const auto relative = std::filesystem::relative(entry.path(), root);
+            CodegenAsset asset;
+            asset.source = entry.path();
+            if (entry.is_directory() && std::filesystem::exists(entry.path() / "meta")) {
+                // Everything inside belongs to the animation, including any .bmx
+                // files kept next to the frames.
+                it.disable_recursion_pending();
+                asset.name = relative.generic_string();
+                asset.is_animation = true;
+            } else if (entry.is_regular_file() && entry.path().extension() == ".bmx") {
+                asset.name = (relative.parent_path() / relative.stem()).generic_string();
+            } else {
+                continue;
+            }
+            assets.push_back(std::move(asset));
+        }
+        std::sort(assets.begin(), assets.end(), [](const CodegenAsset& a, const CodegenAsset& b) { return a.name < b.name; });
+        return assets;
+    }
+
+    void writeByteArray(std::ostringstream& out, const std::string& symbol, const std::vector<uint8_t>& bytes) {
+        static constexpr char hex[] = "0123456789abcdef";
+        out << "    constexpr uint8_t " << symbol << "[] = {";
+        for (size_t i = 0; i < bytes.size(); ++i) {
+            out << (i % 16 == 0 ? "\n        " : " ") << "0x" << hex[bytes[i] >> 4] << hex[bytes[i] & 0xF] << ",";
+        }
+        out << "\n    };\n";
+    }
+
+    std::string generateHeader(const std::string& ns, const std::vector<CodegenAsset>& assets, const std::vector<std::string>& ids) {
+        std::ostringstream out;
+        out << "// Generated by flipit codegen. Do not edit.\n"
+            << "#pragma once\n\n"
+            << "#include <cstddef>\n"
+            << "#include <cstdint>\n\n"
+            << "namespace " << ns << " {\n\n"
+            << "// One frame in .bm layout: a flag byte, then raw packed bits (0x00) or\n"
+            << "// a reserved byte, a little-endian 16-bit length and a heatshrink 8/4\n"
+            << "// stream (0x01).\n"
+            << "struct IconFrame {\n"
+            << "    const uint8_t* data;\n"
+            << "    uint32_t size;\n"
+            << "};\n\n"
+            << "struct Icon {\n"
+            << "    const char* name;\n"
+            << "    uint32_t width;\n"
+            << "    uint32_t height;\n"
+            << "    uint32_t frame_count;\n"
+            << "    uint32_t frame_rate;\n"
+            << "    const IconFrame* frames;\n"
+            << "};\n\n"
+            << "enum class IconId : uint16_t {\n";
+        for (size_t i = 0; i < assets.size(); ++i) out << "    " << ids[i] << ",\n";
+        out << "    " << COUNT_ENUMERATOR << "\n"
+            << "};\n\n"
+            << "constexpr size_t ICON_COUNT = " << assets.size() << ";\n"
+            << "extern const Icon ICONS[ICON_COUNT];\n\n"
+            << "const Icon& getIcon(IconId id);\n"
+            << "// Looks an icon up by asset name (relative path without extension).\n"
+            << "const Icon* findIcon(const char* name);\n\n"
+            << "} // namespace " << ns << "\n";
+        return out.str();
+    }
+
+    std::string generateSource(const std::string& ns, const std::string& header_name,
+                               const std::vector<CodegenAsset>& assets, const std::vector<std::string>& ids, size_t& unique_frames) {
+        std::ostringstream out;
+        out << "// Generated by flipit codegen. Do not edit.\n"
+            << "#include \"" << header_name << "\"\n\n"
+            << "#include <cstring>\n\n"
+            << "namespace " << ns << " {\n\n"
+            << "namespace {\n";
+
+        // Identical frames (within or across assets) share one array.
+        std::map<std::vector<uint8_t>, std::string> frame_symbols;
+        std::vector<std::vector<std::string>> asset_frame_symbols(assets.size());
+        for (size_t a = 0; a < assets.size(); ++a) {
+            for (const auto& frame : assets[a].frames) {
+                auto [it, inserted] = frame_symbols.try_emplace(frame, "frame_" + std::to_string(frame_symbols.size()));
+                if (inserted) writeByteArray(out, it->second, frame);
+                asset_frame_symbols[a].push_back(it->second);
+            }
+        }
+        unique_frames = frame_symbols.size();
+
+        for (size_t a = 0; a < assets.size(); ++a) {
+            out << "\n    constexpr IconFrame " << ids[a] << "_frames[] = {\n";
+            for (size_t f = 0; f < assets[a].frames.size(); ++f)
+                out << "        {" << asset_frame_symbols[a][f] << ", " << assets[a].frames[f].size() << "},\n";
+            out << "    };\n";
+        }
+
+        out << "}\n\n"
+            << "const Icon ICONS[ICON_COUNT] = {\n";
+        for (size_t a = 0; a < assets.size(); ++a) {
+            const auto& asset = assets[a];
+            out << "    {\"" << escapeCString(asset.name) << "\", " << asset.width << ", " << asset.height << ", " << asset.frames.size()
+                << ", " << asset.frame_rate << ", " << ids[a] << "_frames},\n";
+        }
+        out << "};\n\n"
+            << "const Icon& getIcon(const IconId id) {\n"
+            << "    return ICONS[static_cast<size_t>(id)];\n"
+            << "}\n\n"
+            << "const Icon* findIcon(const char* name) {\n"
+            << "    // ICONS is sorted by name.\n"
+            << "    size_t lo = 0, hi = ICON_COUNT;\n"
+            << "    while (lo < hi) {\n"
+            << "        const size_t mid = (lo + hi) / 2;\n"
+            << "        const int cmp = std::strcmp(ICONS[mid].name, name);\n"
+            << "        if (cmp == 0) return &ICONS[mid];\n"
+            << "        if (cmp < 0) lo = mid + 1;\n"
+            << "        else hi = mid;\n"
+            << "    }\n"
+            << "    return nullptr;\n"
+            << "}\n\n"
+            << "} // namespace " << ns << "\n";
+        return out.str();
+    }
+
+    // Leaves the file (and its timestamp) alone when the content is unchanged,
+    // so the build system does not recompile the generated tables.
+    bool writeIfChanged(const std::filesystem::path& path, const std::string& content) {
+        if (std::filesystem::exists(path)) {
+            const auto existing = readFile(path.string());
+            if (existing.size() == content.size() && std::equal(existing.begin(), existing.end(), content.begin()))
+                return false;
+        }
+        std::ofstream f(path, std::ios::binary);
+        if (!f) throw std::runtime_error("Failed to write " + path.string());
+        f << content;
+        return true;
+    }
+
+    // <output_base>.cache keeps every asset's loaded frames keyed by source
+    // path and stamp, so a rerun only reloads and revalidates what changed.
+    constexpr char CACHE_MAGIC[] = "flipit-codegen-cache 1\n";
+
+    void putU32(std::string& out, const uint32_t value) {
+        for (int shift = 0; shift < 32; shift += 8) out += static_cast<char>(value >> shift & 0xFF);
+    }
+
+    void putBlob(std::string& out, const std::string& blob) {
+        putU32(out, static_cast<uint32_t>(blob.size()));
+        out += blob;
+    }
+
+    struct CacheReader {
+        const std::vector<uint8_t>& data;
+        size_t pos = 0;
+
+        uint32_t u32() {
+            if (data.size() - pos < 4) throw std::runtime_error("Truncated codegen cache");
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i) value |= static_cast<uint32_t>(data[pos++]) << (8 * i);
+            return value;
+        }
+
+        std::vector<uint8_t> blob() {
+            const uint32_t size = u32();
+            if (data.size() - pos < size) throw std::runtime_error("Truncated codegen cache");
+            pos += size;
+            return {data.begin() + static_cast<std::ptrdiff_t>(pos - size), data.begin() + static_cast<std::ptrdiff_t>(pos)};
+        }
+
+        std::string string() {
+            const auto bytes = blob();
+            return {bytes.begin(), bytes.end()};
+        }
+    };
+
+    std::string serializeCache(const std::vector<CodegenAsset>& assets) {
+        std::string out = CACHE_MAGIC;
+        putU32(out, static_cast<uint32_t>(assets.size()));
+        for (const auto& asset : assets) {
+            putBlob(out, asset.source.generic_string());
+            putBlob(out, asset.stamp);
+            putU32(out, asset.width);
+            putU32(out, asset.height);
+            putU32(out, asset.frame_rate);
+            putU32(out, static_cast<uint32_t>(asset.frames.size()));
+            for (const auto& frame : asset.frames) putBlob(out, std::string(frame.begin(), frame.end()));
+        }
+        return out;
+    }
+
+    // A missing, stale-format or damaged cache just means everything reloads.
+    std::map<std::string, CodegenAsset> readCache(const std::filesystem::path& path) {
+        std::map<std::string, CodegenAsset> cached;
+        if (!std::filesystem::exists(path)) return cached;
+        try {
+            const auto data = readFile(path.string());
+            constexpr size_t magic_size = sizeof(CACHE_MAGIC) - 1;
+            if (data.size() < magic_size || !std::equal(CACHE_MAGIC, CACHE_MAGIC + magic_size, data.begin())) return {};
+
+            CacheReader reader{data, magic_size};
+            for (uint32_t count = reader.u32(); count > 0; --count) {
+                CodegenAsset asset;
+                const std::string source = reader.string();
+                asset.stamp = reader.string();
+                asset.width = reader.u32();
+                asset.height = reader.u32();
+                asset.frame_rate = reader.u32();
+                for (uint32_t frames = reader.u32(); frames > 0; --frames) asset.frames.push_back(reader.blob());
+                cached[source] = std::move(asset);
+            }
+        } catch (const std::exception&) {
+            return {};
+        }
+        return cached;
+    }
+}
+
+int runCodegen(const int argc, char** argv) {
+    if (argc < 4) {
+        std::cerr << "Usage: tool codegen <asset_dir> <output_base> [--jobs N]\n";
+        return 1;
+    }
+
+    const std::filesystem::path asset_dir = argv[2];
+    const std::filesystem::path output_base = argv[3];
+    size_t jobs = 0;
+    for (int i = 4; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--jobs" && i + 1 < argc) jobs = std::stoul(argv[++i]);
+        else {
+            std::cerr << "Unknown codegen option: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    auto assets = collectAssets(asset_dir);
+    if (assets.empty()) {
+        // A zero-length ICONS table would not compile.
+        std::cerr << "No .bmx files or animation directories found in " << asset_dir.string() << "\n";
+        return 1;
+    }
+
+    const std::filesystem::path cache_path = output_base.string() + ".cache";
+    auto cached = readCache(cache_path);
+    std::vector<size_t> to_load;
+    for (size_t i = 0; i < assets.size(); ++i) {
+        auto& asset = assets[i];
+        asset.stamp = sourceStamp(asset);
+        const auto hit = cached.find(asset.source.generic_string());
+        if (hit != cached.end() && hit->second.stamp == asset.stamp) {
+            asset.width = hit->second.width;
+            asset.height = hit->second.height;
+            asset.frame_rate = hit->second.frame_rate;
+            asset.frames = std::move(hit->second.frames);
+        } else {
+            to_load.push_back(i);
+        }
+    }
+
+    ThreadPool pool(jobs);
+    parallelFor(pool, to_load.size(), [&](const size_t i) { loadAsset(assets[to_load[i]]); });
+
+    std::vector<std::string> ids;
+    for (const auto& asset : assets) {
+        std::string id = sanitizeIdentifier(asset.name);
+        while (id == COUNT_ENUMERATOR || std::find(ids.begin(), ids.end(), id) != ids.end()) id += "_";
+        ids.push_back(id);
+    }
+
+    const std::string ns = sanitizeIdentifier(output_base.stem().string());
+    const std::filesystem::path header_path = output_base.string() + ".h";
+    const std::filesystem::path source_path = output_base.string() + ".cpp";
+    if (output_base.has_parent_path()) std::filesystem::create_directories(output_base.parent_path());
+
+    size_t frame_count = 0;
+    for (const auto& asset : assets) frame_count += asset.frames.size();
+    size_t unique_frames = 0;
+
+    const bool header_written = writeIfChanged(header_path, generateHeader(ns, assets, ids));
+    const bool source_written = writeIfChanged(source_path, generateSource(ns, header_path.filename().string(), assets, ids, unique_frames));
+    writeIfChanged(cache_path, serializeCache(assets));
+
+    std::cout << "Generated " << assets.size() << " icons, " << frame_count << " frames (" << unique_frames << " unique), "
+              << to_load.size() << " loaded, " << assets.size() - to_load.size() << " cached\n"
+              << "  " << header_path.string() << (header_written ? "" : " (unchanged)") << "\n"
+              << "  " << source_path.string() << (source_written ? "" : " (unchanged)") << "\n";
+    return 0;
+}
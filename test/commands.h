@@ -0,0 +1,26 @@
+#pragma once
+
+// Subcommands that live outside main.cpp. Each receives the full argv and
+// returns the process exit code.
+int runBench(int argc, char** argv);
+int runCheck(int argc, char** argv);
+int runAnalyze(int argc, char** argv);
+int runSweep(int argc, char** argv);
+int runCodegen(int argc, char** argv);
+int runProbe(int argc, char** argv);
+int runServe(int argc, char** argv);
+int runIngest(int argc, char** argv);
+int runGif2Anim(int argc, char** argv);
+int runPng2Bm(int argc, char** argv);
+int runAnim2Apng(int argc, char** argv);
+
+// Image conversion options shared by the commands that read PNG/GIF/PGM
+// input: --background 0-255, --dither MODE, --threshold N|auto,
+// --max-flips N, --resize WxH[,WxH...] and --resize-filter F. Consumes argv[i] (and its value) and returns true when it
+// is one of them.
+struct ConvertOptions;
+bool parseConvertOption(int argc, char** argv, int& i, ConvertOptions& options);
+
+// Sends a bmx2png/png2bmx/probe invocation to a running `flipit serve`.
+// Returns false when there is no daemon, so the caller runs the command itself.
+bool forwardToDaemon(int argc, char** argv, int& exit_code);
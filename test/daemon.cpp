@@ -0,0 +1,470 @@
+#include "commands.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bm_utils.h"
+#include "png_writer.h"
+#include "thread_pool.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FLIPIT_HAS_DAEMON 1
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Wire protocol between `flipit serve` and its clients, host byte order:
+//
+//   request:  u32 magic, u32 count, count x { u8 op, u32 len, input path, u32 len, output path }
+//   response: per finished op, in completion order: { u32 index, u8 ok, u32 len, payload }
+//             then u32 0xFFFFFFFF
+//
+// The payload is the message the local command would have printed, the error
+// text when ok is 0, or the packed bits for a decode request.
+
+namespace {
+    enum class DaemonOp : uint8_t {
+        Png2Bmx = 1,
+        Bmx2Png = 2,
+        Decode = 3,
+        Probe = 4,
+    };
+
+    constexpr uint32_t DAEMON_MAGIC = 0x54504C46; // "FLPT"
+    constexpr uint32_t END_OF_RESULTS = 0xFFFFFFFF;
+    constexpr size_t CACHE_LIMIT = 4096;
+
+    struct DaemonRequest {
+        DaemonOp op;
+        std::string input;
+        std::string output;
+    };
+
+    std::string payloadText(const std::vector<uint8_t>& payload) {
+        return {payload.begin(), payload.end()};
+    }
+
+    std::vector<uint8_t> textPayload(const std::string& text) {
+        return {text.begin(), text.end()};
+    }
+
+    std::string describeBmx(const std::string& path) {
+        const BmxHeader header = readBmxHeader(readFile(path));
+        std::string text = path + ": " + std::to_string(header.width) + "x" + std::to_string(header.height) + ", ";
+        text += header.is_compressed ? "compressed (" + std::to_string(header.compressed_size) + " bytes)" : "uncompressed";
+        return text + "\n";
+    }
+
+    void writeOutput(const std::string& path, const std::vector<uint8_t>& bytes) {
+        std::ofstream f(path, std::ios::binary);
+        if (!f || !f.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size())))
+            throw std::runtime_error("Failed to write " + path);
+    }
+
+    // Converted outputs keyed by input path, reused while the input's size
+    // and modification time stay the same.
+    class ConversionCache {
+    public:
+        bool lookup(const DaemonRequest& request, std::vector<uint8_t>& output) {
+            const auto key = cacheKey(request);
+            const auto stamp = fileStamp(request.input);
+            std::lock_guard lock(mutex);
+            const auto it = entries.find(key);
+            if (it == entries.end() || it->second.stamp != stamp) return false;
+            output = it->second.output;
+            return true;
+        }
+
+        void store(const DaemonRequest& request, const std::vector<uint8_t>& output) {
+            const auto key = cacheKey(request);
+            const auto stamp = fileStamp(request.input);
+            std::lock_guard lock(mutex);
+            if (entries.size() >= CACHE_LIMIT) entries.clear();
+            entries[key] = {stamp, output};
+        }
+
+    private:
+        struct Entry {
+            std::string stamp;
+            std::vector<uint8_t> output;
+        };
+
+        static std::string cacheKey(const DaemonRequest& request) {
+            return std::to_string(static_cast<int>(request.op)) + ":" + request.input;
+        }
+
+        static std::string fileStamp(const std::string& path) {
+            const auto size = std::filesystem::file_size(path);
+            const auto mtime = std::filesystem::last_write_time(path).time_since_epoch().count();
+            return std::to_string(size) + ":" + std::to_string(mtime);
+        }
+
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> entries;
+    };
+
+    std::vector<uint8_t> runRequest(const DaemonRequest& request, ConversionCache& cache) {
+        switch (request.op) {
+            case DaemonOp::Png2Bmx: {
+                std::vector<uint8_t> bmx;
+                if (!cache.lookup(request, bmx)) {
+                    bmx = convertImageToBMX(readFile(request.input));
+                    cache.store(request, bmx);
+                }
+                writeOutput(request.output, bmx);
+                return textPayload("Converted PNG to BMX: " + request.output + "\n");
+            }
+            case DaemonOp::Bmx2Png: {
+                std::vector<uint8_t> png;
+                BmxHeader info{};
+                if (!cache.lookup(request, png)) {
+                    const auto bitData = decodeBMX(readFile(request.input), info);
+                    png = encodePackedPNG(bitData, info.width, info.height);
+                    cache.store(request, png);
+                }
+                writeOutput(request.output, png);
+                return textPayload("Saved PNG as " + request.output + "\n");
+            }
+            case DaemonOp::Decode: {
+                BmxHeader info{};
+                return decodeBMX(readFile(request.input), info);
+            }
+            case DaemonOp::Probe:
+                return textPayload(describeBmx(request.input));
+        }
+        throw std::runtime_error("Unknown daemon request");
+    }
+
+#ifdef FLIPIT_HAS_DAEMON
+    // Without XDG_RUNTIME_DIR the socket lives in a directory only this user
+    // can enter, so no one else can pre-bind or replace it.
+    std::string fallbackSocketDir() {
+        return "/tmp/flipit-" + std::to_string(getuid());
+    }
+
+    // A real directory (not a symlink) owned by this user, without group or
+    // other permissions.
+    bool isPrivateDir(const std::string& dir) {
+        struct stat st{};
+        return lstat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode) && st.st_uid == getuid() && (st.st_mode & 077) == 0;
+    }
+#endif
+
+    std::string defaultSocketPath() {
+        if (const char* path = std::getenv("FLIPIT_SOCKET")) return path;
+        if (const char* dir = std::getenv("XDG_RUNTIME_DIR")) return std::string(dir) + "/flipit.sock";
+#ifdef FLIPIT_HAS_DAEMON
+        return fallbackSocketDir() + "/flipit.sock";
+#else
+        return "flipit.sock";
+#endif
+    }
+
+#ifdef FLIPIT_HAS_DAEMON
+    // Both ends only talk to processes of the same user: the daemon reads and
+    // writes files for its clients, and a client trusts the daemon's output.
+    bool peerIsCurrentUser(const int fd) {
+#ifdef SO_PEERCRED
+        ucred credentials{};
+        socklen_t size = sizeof(credentials);
+        return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) == 0 && credentials.uid == getuid();
+#else
+        uid_t uid = 0;
+        gid_t gid = 0;
+        return getpeereid(fd, &uid, &gid) == 0 && uid == getuid();
+#endif
+    }
+
+    bool readAll(const int fd, void* buffer, size_t size) {
+        auto* out = static_cast<uint8_t*>(buffer);
+        while (size > 0) {
+            const ssize_t n = read(fd, out, size);
+            if (n <= 0) return false;
+            out += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool writeAll(const int fd, const void* buffer, size_t size) {
+        const auto* in = static_cast<const uint8_t*>(buffer);
+        while (size > 0) {
+            const ssize_t n = write(fd, in, size);
+            if (n <= 0) return false;
+            in += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    template <typename T>
+    bool readValue(const int fd, T& value) {
+        return readAll(fd, &value, sizeof(value));
+    }
+
+    bool readString(const int fd, std::string& value) {
+        uint32_t size = 0;
+        if (!readValue(fd, size) || size > 4096) return false;
+        value.resize(size);
+        return readAll(fd, value.data(), size);
+    }
+
+    void appendString(std::vector<uint8_t>& message, const std::string& value) {
+        const auto size = static_cast<uint32_t>(value.size());
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&size);
+        message.insert(message.end(), bytes, bytes + sizeof(size));
+        message.insert(message.end(), value.begin(), value.end());
+    }
+
+    sockaddr_un socketAddress(const std::string& path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) throw std::runtime_error("Socket path too long: " + path);
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        return address;
+    }
+
+    int connectToDaemon(const std::string& path) {
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        const sockaddr_un address = socketAddress(path);
+        if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || !peerIsCurrentUser(fd)) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    volatile std::sig_atomic_t stop_requested = 0;
+
+    void handleStopSignal(int) {
+        stop_requested = 1;
+    }
+
+    struct Connection {
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+
+    void serveConnection(const int fd, ThreadPool& pool, ConversionCache& cache) {
+        uint32_t magic = 0, count = 0;
+        std::vector<DaemonRequest> requests;
+        if (readValue(fd, magic) && magic == DAEMON_MAGIC && readValue(fd, count)) {
+            for (uint32_t i = 0; i < count; ++i) {
+                uint8_t op = 0;
+                DaemonRequest request{};
+                if (!readValue(fd, op) || !readString(fd, request.input) || !readString(fd, request.output)) break;
+                request.op = static_cast<DaemonOp>(op);
+                requests.push_back(std::move(request));
+            }
+        }
+
+        // Results are written back as soon as each job finishes.
+        std::mutex write_mutex;
+        std::vector<std::future<void>> jobs;
+        for (uint32_t i = 0; i < requests.size(); ++i) {
+            jobs.push_back(pool.submit([&, i] {
+                uint8_t ok = 1;
+                std::vector<uint8_t> payload;
+                try {
+                    payload = runRequest(requests[i], cache);
+                } catch (const std::exception& e) {
+                    ok = 0;
+                    payload = textPayload(e.what());
+                }
+                const auto size = static_cast<uint32_t>(payload.size());
+                std::vector<uint8_t> response(sizeof(i) + sizeof(ok) + sizeof(size));
+                std::memcpy(response.data(), &i, sizeof(i));
+                response[sizeof(i)] = ok;
+                std::memcpy(response.data() + sizeof(i) + sizeof(ok), &size, sizeof(size));
+                response.insert(response.end(), payload.begin(), payload.end());
+
+                std::lock_guard lock(write_mutex);
+                writeAll(fd, response.data(), response.size());
+            }));
+        }
+        for (auto& job : jobs) job.wait();
+
+        writeAll(fd, &END_OF_RESULTS, sizeof(END_OF_RESULTS));
+        close(fd);
+    }
+#endif
+}
+
+int runServe(const int argc, char** argv) {
+    std::string socket_path = defaultSocketPath();
+    size_t jobs = 0;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) socket_path = argv[++i];
+        else if (arg == "--jobs" && i + 1 < argc) jobs = std::stoul(argv[++i]);
+        else {
+            std::cerr << "Unknown serve option: " << arg << "\n";
+            return 1;
+        }
+    }
+
+#ifdef FLIPIT_HAS_DAEMON
+    if (socket_path == fallbackSocketDir() + "/flipit.sock") {
+        mkdir(fallbackSocketDir().c_str(), 0700);
+        if (!isPrivateDir(fallbackSocketDir()))
+            throw std::runtime_error(fallbackSocketDir() + " is not a private directory owned by this user; set XDG_RUNTIME_DIR or use --socket");
+    }
+    if (const int existing = connectToDaemon(socket_path); existing >= 0) {
+        close(existing);
+        std::cerr << "A daemon is already listening on " << socket_path << "\n";
+        return 1;
+    }
+    unlink(socket_path.c_str()); // stale socket from a daemon that did not shut down cleanly
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) throw std::runtime_error("Failed to create socket");
+    const sockaddr_un address = socketAddress(socket_path);
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || chmod(socket_path.c_str(), 0600) != 0 ||
+        listen(listener, 64) != 0) {
+        close(listener);
+        throw std::runtime_error("Failed to listen on " + socket_path);
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, handleStopSignal);
+    std::signal(SIGTERM, handleStopSignal);
+
+    ThreadPool pool(jobs);
+    ConversionCache cache;
+    std::vector<std::unique_ptr<Connection>> connections;
+    std::cout << "Listening on " << socket_path << " with " << pool.size() << " worker threads\n";
+
+    while (!stop_requested) {
+        pollfd pfd{listener, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) continue;
+
+        const int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) continue;
+        if (!peerIsCurrentUser(fd)) {
+            close(fd);
+            continue;
+        }
+
+        auto connection = std::make_unique<Connection>();
+        connection->thread = std::thread([fd, &pool, &cache, done = &connection->done] {
+            serveConnection(fd, pool, cache);
+            done->store(true);
+        });
+        connections.push_back(std::move(connection));
+
+        std::erase_if(connections, [](const std::unique_ptr<Connection>& c) {
+            if (!c->done.load()) return false;
+            c->thread.join();
+            return true;
+        });
+    }
+
+    for (const auto& connection : connections) connection->thread.join();
+    close(listener);
+    unlink(socket_path.c_str());
+    std::cout << "Daemon stopped\n";
+    return 0;
+#else
+    std::cerr << "flipit serve needs Unix domain sockets, which this platform does not provide\n";
+    return 1;
+#endif
+}
+
+bool forwardToDaemon(const int argc, char** argv, int& exit_code) {
+#ifdef FLIPIT_HAS_DAEMON
+    if (std::getenv("FLIPIT_NO_DAEMON") || argc < 3) return false;
+
+    const std::string command = argv[1];
+    std::vector<DaemonRequest> requests;
+    const auto absolute = [](const std::string& path) { return std::filesystem::absolute(path).string(); };
+
+    if (command == "png2bmx" || command == "bmx2png") {
+        const std::string input_file = argv[2];
+        const std::string ext = command == "png2bmx" ? ".bmx" : ".png";
+        const std::string output_file = (argc > 3) ? argv[3] : std::filesystem::path(input_file).stem().string() + ext;
+        // The daemon cannot see this process's stdin/stdout, and it only
+        // runs the default conversion, so anything with options stays local.
+        if (input_file == "-" || output_file == "-" || argc > 4 || output_file.rfind("--", 0) == 0) return false;
+        requests.push_back({command == "png2bmx" ? DaemonOp::Png2Bmx : DaemonOp::Bmx2Png, absolute(input_file), absolute(output_file)});
+    } else if (command == "probe") {
+        for (int i = 2; i < argc; ++i) requests.push_back({DaemonOp::Probe, absolute(argv[i]), ""});
+    } else {
+        return false;
+    }
+
+    const int fd = connectToDaemon(defaultSocketPath());
+    if (fd < 0) return false;
+
+    std::vector<uint8_t> message;
+    const uint32_t header[2] = {DAEMON_MAGIC, static_cast<uint32_t>(requests.size())};
+    const auto* header_bytes = reinterpret_cast<const uint8_t*>(header);
+    message.insert(message.end(), header_bytes, header_bytes + sizeof(header));
+    for (const auto& request : requests) {
+        message.push_back(static_cast<uint8_t>(request.op));
+        appendString(message, request.input);
+        appendString(message, request.output);
+    }
+    if (!writeAll(fd, message.data(), message.size())) {
+        close(fd);
+        return false;
+    }
+
+    exit_code = 0;
+    size_t received = 0;
+    while (true) {
+        uint32_t index = 0, size = 0;
+        uint8_t ok = 0;
+        if (!readValue(fd, index) || index == END_OF_RESULTS) break;
+        std::vector<uint8_t> payload;
+        if (!readValue(fd, ok) || !readValue(fd, size)) break;
+        payload.resize(size);
+        if (!readAll(fd, payload.data(), size)) break;
+
+        ++received;
+        if (ok) std::cout << payloadText(payload);
+        else {
+            std::cerr << "Error: " << payloadText(payload) << "\n";
+            exit_code = 1;
+        }
+    }
+    close(fd);
+
+    if (received != requests.size()) {
+        std::cerr << "Error: daemon connection closed early\n";
+        exit_code = 1;
+    }
+    return true;
+#else
+    (void)argc;
+    (void)argv;
+    (void)exit_code;
+    return false;
+#endif
+}
+
+int runProbe(const int argc, char** argv) {
+    int status = 0;
+    for (int i = 2; i < argc; ++i) {
+        try {
+            std::cout << describeBmx(argv[i]);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << argv[i] << ": " << e.what() << "\n";
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,289 @@
+#include "commands.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bit_reverse.h"
+#include "bm_utils.h"
+#include "pbm.h"
+#include "thread_pool.h"
+
+namespace {
+    enum class StreamFormat { Netpbm, Y4m };
+
+    // Minimal buffered reader over a FILE*; headers are parsed byte by byte,
+    // pixel planes are read in one call.
+    class StreamReader {
+    public:
+        explicit StreamReader(std::FILE* file) : file(file) {}
+
+        int peek() {
+            const int c = std::getc(file);
+            if (c != EOF) std::ungetc(c, file);
+            return c;
+        }
+        int get() { return std::getc(file); }
+
+        void read(uint8_t* data, const size_t size) {
+            if (std::fread(data, 1, size, file) != size) throw std::runtime_error("Truncated frame data");
+        }
+
+        void skip(size_t size) {
+            uint8_t scratch[4096];
+            while (size > 0) {
+                const size_t chunk = std::min(size, sizeof(scratch));
+                read(scratch, chunk);
+                size -= chunk;
+            }
+        }
+
+        std::string readLine() {
+            std::string line;
+            for (int c = get(); c != '\n'; c = get()) {
+                if (c == EOF) throw std::runtime_error("Unexpected end of stream in header");
+                line += static_cast<char>(c);
+            }
+            return line;
+        }
+
+        bool atEnd() { return peek() == EOF; }
+
+    private:
+        std::FILE* file;
+    };
+
+    struct StreamInfo {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t frame_rate = 0;
+        size_t chroma_size = 0; // Y4M bytes to skip after the luma plane
+    };
+
+    // One frame off the stream: 8-bit luma, or packed bits for PBM input.
+    struct Frame {
+        std::vector<uint8_t> data;
+        bool packed = false;
+    };
+
+    // --- PGM (P5) / PBM (P4), one image after another ---
+
+    uint32_t readPgmNumber(StreamReader& in) {
+        int c = in.get();
+        while (c == '#' || std::isspace(c)) {
+            if (c == '#') while (c != '\n' && c != EOF) c = in.get();
+            c = in.get();
+        }
+        if (c < '0' || c > '9') throw std::runtime_error("Malformed PGM header");
+        uint32_t value = 0;
+        for (; c >= '0' && c <= '9'; c = in.get()) value = value * 10 + static_cast<uint32_t>(c - '0');
+        // Exactly one whitespace byte separates maxval from the raster; it was consumed above.
+        return value;
+    }
+
+    // Reads the next P5 image into an 8-bit luma frame, or the next P4 image
+    // into packed bits. Returns false at end of stream.
+    bool readNetpbmFrame(StreamReader& in, StreamInfo& info, Frame& out) {
+        while (std::isspace(in.peek())) in.get();
+        if (in.atEnd()) return false;
+        const int magic = in.get() == 'P' ? in.get() : EOF;
+        if (magic != '5' && magic != '4') throw std::runtime_error("Expected a binary PGM (P5) or PBM (P4) frame");
+
+        const uint32_t width = readPgmNumber(in);
+        const uint32_t height = readPgmNumber(in);
+        const uint32_t maxval = magic == '4' ? 1 : readPgmNumber(in);
+        if (width == 0 || height == 0 || maxval == 0 || maxval > 65535) throw std::runtime_error("Invalid PGM dimensions or maxval");
+        if (info.width == 0) {
+            info.width = width;
+            info.height = height;
+        } else if (width != info.width || height != info.height) {
+            throw std::runtime_error("Frame size changed mid-stream");
+        }
+
+        // PBM rows are already packed, only MSB-first; BMX wants LSB-first.
+        out.packed = magic == '4';
+        if (out.packed) {
+            out.data.resize(static_cast<size_t>(height) * ((width + 7) / 8));
+            in.read(out.data.data(), out.data.size());
+            reverseBits(out.data.data(), out.data.data(), out.data.size());
+            clearRowPadding(out.data.data(), width, height);
+            return true;
+        }
+
+        std::vector<uint8_t>& frame = out.data;
+        const size_t pixels = static_cast<size_t>(width) * height;
+        frame.resize(pixels);
+        if (maxval == 255) {
+            in.read(frame.data(), pixels);
+            return true;
+        }
+
+        // Other depths are rescaled to 0..255 so the 128 threshold keeps its meaning.
+        const size_t sample_bytes = maxval > 255 ? 2 : 1;
+        std::vector<uint8_t> raw(pixels * sample_bytes);
+        in.read(raw.data(), raw.size());
+        for (size_t i = 0; i < pixels; ++i) {
+            const uint32_t sample = sample_bytes == 2 ? (raw[2 * i] << 8 | raw[2 * i + 1]) : raw[i];
+            frame[i] = static_cast<uint8_t>(std::min(sample, maxval) * 255 / maxval);
+        }
+        return true;
+    }
+
+    // --- YUV4MPEG2: one stream header, then FRAME lines followed by planes ---
+
+    void readY4mHeader(StreamReader& in, StreamInfo& info) {
+        const std::string header = in.readLine();
+        if (header.rfind("YUV4MPEG2", 0) != 0) throw std::runtime_error("Expected a YUV4MPEG2 stream header");
+
+        std::string colorspace = "420";
+        size_t pos = header.find(' ');
+        while (pos != std::string::npos) {
+            const size_t end = header.find(' ', pos + 1);
+            const std::string token = header.substr(pos + 1, end == std::string::npos ? std::string::npos : end - pos - 1);
+            pos = end;
+            if (token.empty()) continue;
+            const std::string value = token.substr(1);
+            switch (token[0]) {
+                case 'W': info.width = static_cast<uint32_t>(std::stoul(value)); break;
+                case 'H': info.height = static_cast<uint32_t>(std::stoul(value)); break;
+                case 'C': colorspace = value; break;
+                case 'F': {
+                    const size_t colon = value.find(':');
+                    const double num = std::stod(value.substr(0, colon));
+                    const double den = colon == std::string::npos ? 1.0 : std::stod(value.substr(colon + 1));
+                    if (den > 0) info.frame_rate = static_cast<uint32_t>(num / den + 0.5);
+                    break;
+                }
+                default: break; // interlacing, aspect ratio and extensions do not matter for 1-bit frames
+            }
+        }
+        if (info.width == 0 || info.height == 0) throw std::runtime_error("Y4M header lacks W/H");
+
+        const size_t half_w = (info.width + 1) / 2, half_h = (info.height + 1) / 2;
+        const size_t luma = static_cast<size_t>(info.width) * info.height;
+        // High bit depth variants are spelled 420p10, 444p12, mono16, ...
+        const size_t depth = colorspace.rfind("mono", 0) == 0 ? 4 : colorspace.rfind('p') + 1;
+        if (depth > 0 && depth < colorspace.size() && colorspace.find_first_not_of("0123456789", depth) == std::string::npos)
+            throw std::runtime_error("High bit depth Y4M (" + colorspace + ") is not supported");
+        if (colorspace == "mono") info.chroma_size = 0;
+        else if (colorspace == "444alpha") info.chroma_size = 3 * luma;
+        else if (colorspace.rfind("444", 0) == 0) info.chroma_size = 2 * luma;
+        else if (colorspace.rfind("422", 0) == 0) info.chroma_size = 2 * half_w * info.height;
+        else if (colorspace.rfind("420", 0) == 0) info.chroma_size = 2 * half_w * half_h;
+        else if (colorspace.rfind("411", 0) == 0) info.chroma_size = 2 * ((info.width + 3) / 4) * info.height;
+        else throw std::runtime_error("Unsupported Y4M colorspace: " + colorspace);
+    }
+
+    bool readY4mFrame(StreamReader& in, const StreamInfo& info, Frame& frame) {
+        if (in.atEnd()) return false;
+        if (in.readLine().rfind("FRAME", 0) != 0) throw std::runtime_error("Expected a Y4M FRAME marker");
+        frame.data.resize(static_cast<size_t>(info.width) * info.height);
+        in.read(frame.data.data(), frame.data.size());
+        in.skip(info.chroma_size);
+        return true;
+    }
+
+    std::string frameName(const uint32_t index) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%02u.bm", index);
+        return name;
+    }
+}
+
+int runIngest(const int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: tool ingest <output_dir> [--fps N] [--jobs N] [--dither MODE] [--threshold N|auto]\n"
+                  << "       [--resize WxH] [--resize-filter F] < frames.(pgm|pbm|y4m)\n"
+                  << "  Frame rate is --fps, else the Y4M header rate, else 10.\n";
+        return 1;
+    }
+
+    const std::filesystem::path output_dir = argv[2];
+    uint32_t fps_override = 0;
+    size_t jobs = 0;
+    ConvertOptions options;
+    for (int i = 3; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--fps" && i + 1 < argc) fps_override = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (arg == "--jobs" && i + 1 < argc) jobs = std::stoul(argv[++i]);
+        else if (parseConvertOption(argc, argv, i, options)) continue;
+        else {
+            std::cerr << "Unknown ingest option: " << arg << "\n";
+            return 1;
+        }
+    }
+    if (options.sizes.size() > 1) {
+        std::cerr << "ingest takes a single --resize size\n";
+        return 1;
+    }
+
+    StreamReader in(stdin);
+    while (std::isspace(in.peek())) in.get();
+    const StreamFormat format = in.peek() == 'Y' ? StreamFormat::Y4m : StreamFormat::Netpbm;
+
+    StreamInfo info;
+    if (format == StreamFormat::Y4m) readY4mHeader(in, info);
+    std::filesystem::create_directories(output_dir);
+
+    ThreadPool pool(jobs);
+    // Frames in flight are capped, so memory does not grow with clip length:
+    // the reader blocks on the oldest frame once the workers fall behind.
+    const size_t max_in_flight = pool.size() * 2;
+    std::deque<std::future<void>> in_flight;
+
+    const auto start = std::chrono::steady_clock::now();
+    uint32_t frame_count = 0;
+    Frame frame;
+    while (format == StreamFormat::Y4m ? readY4mFrame(in, info, frame) : readNetpbmFrame(in, info, frame)) {
+        if (in_flight.size() >= max_in_flight) {
+            in_flight.front().get();
+            in_flight.pop_front();
+        }
+
+        const std::string path = (output_dir / frameName(frame_count)).string();
+        in_flight.push_back(pool.submit([frame = std::move(frame), path, width = info.width, height = info.height, options] {
+            // PBM bits are stored as they are unless they have to be resized or reworked.
+            bool written;
+            if (frame.packed && options.sizes.empty() && options.max_flips == 0)
+                written = writeFile(path, encodeBM(frame.data));
+            else if (frame.packed)
+                written = writeBM(path, expandBitData(frame.data, width, height).data(), width, height, options);
+            else
+                written = writeBM(path, frame.data.data(), width, height, options);
+            if (!written) throw std::runtime_error("Failed to write " + path);
+        }));
+        frame = {};
+        ++frame_count;
+    }
+    while (!in_flight.empty()) {
+        in_flight.front().get();
+        in_flight.pop_front();
+    }
+
+    if (frame_count == 0) {
+        std::cerr << "No frames on stdin\n";
+        return 1;
+    }
+
+    const ResizeTarget size = outputSize(options, info.width, info.height);
+    BmMeta meta{};
+    meta.width = size.width;
+    meta.height = size.height;
+    meta.frame_rate = fps_override ? fps_override : (info.frame_rate ? info.frame_rate : 10);
+    meta.frame_count = frame_count;
+    const std::string meta_path = (output_dir / "meta").string();
+    if (!writeBmMeta(meta_path, meta)) throw std::runtime_error("Failed to write " + meta_path);
+
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Ingested " << frame_count << " frames (" << meta.width << "x" << meta.height << " @ " << meta.frame_rate
+              << " fps) in " << elapsed << " ms using " << pool.size() << " threads\n";
+    return 0;
+}
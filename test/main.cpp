@@ -1,19 +1,255 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <string>
 #include <vector>
 #include <filesystem>
+#include "bm_constexpr.h"
 #include "bm_utils.h"
-
-#include "stb_image_write.h"
+#include "commands.h"
+#include "pbm.h"
+#include "png_writer.h"
+#include "thread_pool.h"
+#include "trace.h"
 
 void printUsage() {
     std::cout << "Usage:\n"
               << "  tool bmx2png <input.bmx> [output.png]  - Convert BMX to PNG\n"
-              << "  tool png2bmx <input.png> [output.bmx]  - Convert PNG to BMX\n";
+              << "  tool png2bmx <input.png> [output.bmx] [--dither MODE] [--threshold N|auto] [--background 0-255]\n"
+              << "                                         [--max-flips N] [--resize WxH[,WxH...]] [--resize-filter F]\n"
+              << "                                         - Convert PNG to BMX\n"
+              << "  tool pbm2bmx <input.pbm> [output.bmx]  - Convert a raw PBM (P4) to BMX\n"
+              << "  tool bmx2pbm <input.bmx> [output.pbm]  - Convert BMX to a raw PBM (P4)\n"
+              << "                                           ('-' reads stdin / writes stdout)\n"
+              << "  tool png2bm <input.png> [output.bm]    - Convert PNG to a .bm animation frame\n"
+              << "  tool png2bm <input_dir> <output_dir> [--fps N] [--jobs N] [--dither MODE] [--threshold N|auto]\n"
+              << "                                         [--background 0-255] [--resize WxH] [--resize-filter F]\n"
+              << "                                         - Convert numbered PNGs to .bm frames + meta\n"
+              << "  tool batch <bmx2png|png2bmx> <input_dir> <output_dir> [--jobs N] [--trace trace.json]\n"
+              << "                                         [--png-level 0-9] [--dither MODE] [--threshold N|auto]\n"
+              << "                                         [--background 0-255] [--max-flips N] [--resize WxH[,WxH...]]\n"
+              << "                                         [--resize-filter F]\n"
+              << "                                         - Convert every file in a directory in parallel\n"
+              << "  tool bench <input.bmx> [--iterations N] [--perf]\n"
+              << "                                         - Time codec and bit-packing kernels\n"
+              << "  tool check                             - Round-trip the codecs over short and edge-case inputs\n"
+              << "                                           (configure with -DFLIPIT_SANITIZE=ON to run it under ASan/UBSan)\n"
+              << "  tool analyze <file.bmx|file.bm|dir>... - Heatshrink token statistics and decode cost\n"
+              << "  tool sweep <file.bmx|file.bm|dir>... [--jobs N] [--top N]\n"
+              << "                                         - Compress assets under every (window, lookahead) pair\n"
+              << "  tool codegen <asset_dir> <output_base> [--jobs N]\n"
+              << "                                         - Emit <output_base>.h/.cpp with embedded icon tables\n"
+              << "  tool probe <input.bmx>...              - Print BMX header information\n"
+              << "  tool serve [--socket path] [--jobs N]  - Run a conversion daemon on a Unix socket\n"
+              << "  tool ingest <output_dir> [--fps N] [--jobs N] [--dither MODE] [--threshold N|auto]\n"
+              << "                                         [--resize WxH] [--resize-filter F]\n"
+              << "                                         - Read a PGM/PBM/Y4M frame stream from stdin into .bm frames + meta\n"
+              << "  tool gif2anim <input.gif> <output_dir> [--fps N] [--jobs N] [--dither MODE] [--threshold N|auto]\n"
+              << "                                         [--background 0-255] [--resize WxH] [--resize-filter F]\n"
+              << "                                         - Convert an animated GIF to .bm frames + meta\n"
+              << "  tool anim2apng <anim_dir>... [-o output.png | --output-dir DIR] [--jobs N] [--png-level 0-9]\n"
+              << "                                         - Export .bm animations as animated PNG previews\n"
+              << "\n"
+              << "Dither modes: none (threshold), bayer2, bayer4, bayer8, bluenoise, floyd-steinberg, atkinson.\n"
+              << "--threshold 0-256: gray below it is black (default 128); auto picks Otsu's threshold per image.\n"
+              << "--background is the gray transparent pixels are composited over (default 255, white).\n"
+              << "--max-flips N lets the encoder flip up to N isolated pixels in dithered or noisy areas when that\n"
+              << "shrinks the output file (accepted wherever --dither is).\n"
+              << "--resize WxH resamples before thresholding or dithering; a 0 follows the aspect ratio. Several\n"
+              << "comma-separated sizes (png2bmx and batch only) decode once and write <name>_<W>x<H>.bmx each.\n"
+              << "--resize-filter: auto (area for whole-factor shrinks, else lanczos), area or lanczos.\n"
+              << "bmx2png, png2bmx and probe are forwarded to a running daemon unless FLIPIT_NO_DAEMON is set.\n"
+              << "The socket defaults to $FLIPIT_SOCKET, then $XDG_RUNTIME_DIR/flipit.sock, then\n"
+              << "/tmp/flipit-<uid>/flipit.sock in a 0700 directory. Daemon and clients only talk to the same user.\n";
+}
+
+// "-" is stdin; anything else is a file path.
+std::vector<uint8_t> readInput(const std::string& path) {
+    if (path != "-") return readFile(path);
+    TraceScope trace("read");
+    std::vector<uint8_t> data{std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()};
+    if (std::cin.bad()) throw std::runtime_error("Failed to read stdin");
+    return data;
+}
+
+// "-" is stdout; anything else is a file path.
+void writeOutput(const std::string& path, const std::vector<uint8_t>& data) {
+    TraceScope trace("write");
+    if (path == "-") {
+        std::cout.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!std::cout.flush()) throw std::runtime_error("Failed to write stdout");
+        return;
+    }
+    std::ofstream f(path, std::ios::binary);
+    if (!f.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size())))
+        throw std::runtime_error("Failed to write " + path);
+}
+
+bool parseConvertOption(const int argc, char** argv, int& i, ConvertOptions& options) {
+    const std::string arg = argv[i];
+    if (arg == "--background" && i + 1 < argc) options.background = static_cast<uint8_t>(std::clamp(std::stoi(argv[++i]), 0, 255));
+    else if (arg == "--dither" && i + 1 < argc) options.dither = parseDitherMode(argv[++i]);
+    else if (arg == "--threshold" && i + 1 < argc) {
+        const std::string value = argv[++i];
+        options.threshold = value == "auto" ? AUTO_THRESHOLD : std::clamp(std::stoi(value), 0, 256);
+    } else if (arg == "--max-flips" && i + 1 < argc) options.max_flips = std::stoul(argv[++i]);
+    else if (arg == "--resize" && i + 1 < argc) {
+        const std::string value = argv[++i];
+        options.sizes.clear();
+        for (size_t begin = 0; begin <= value.size();) {
+            const size_t end = std::min(value.find(',', begin), value.size());
+            options.sizes.push_back(parseResizeTarget(value.substr(begin, end - begin)));
+            begin = end + 1;
+        }
+    } else if (arg == "--resize-filter" && i + 1 < argc) options.resize_filter = parseResizeFilter(argv[++i]);
+    else return false;
+    return true;
+}
+
+bool isOption(const std::string& arg) {
+    return arg.rfind("--", 0) == 0;
+}
+
+// Default output name: stdout when reading stdin, else the input stem with a new extension.
+std::string outputPath(const int argc, char** argv, const std::string& extension) {
+    if (argc > 3 && !isOption(argv[3])) return argv[3];
+    const std::string input_file = argv[2];
+    return input_file == "-" ? "-" : std::filesystem::path(input_file).stem().string() + extension;
+}
+
+// path with "_<W>x<H>" added to the stem, for one of several sizes of a BMX file.
+std::string sizedPath(const std::filesystem::path& path, const std::vector<uint8_t>& bmx) {
+    const BmxInfo info = parseBmxHeader(bmx);
+    std::filesystem::path sized = path;
+    sized.replace_filename(path.stem().string() + "_" + std::to_string(info.width) + "x" + std::to_string(info.height) +
+                           path.extension().string());
+    return sized.string();
+}
+
+int runBatch(int argc, char** argv) {
+    if (argc < 5) {
+        printUsage();
+        return 1;
+    }
+
+    const std::string mode = argv[2];
+    const std::filesystem::path input_dir = argv[3];
+    const std::filesystem::path output_dir = argv[4];
+    if (mode != "bmx2png" && mode != "png2bmx") {
+        printUsage();
+        return 1;
+    }
+
+    size_t jobs = 0;
+    std::string trace_file;
+    ConvertOptions options;
+    for (int i = 5; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--jobs" && i + 1 < argc) {
+            jobs = std::stoul(argv[++i]);
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_file = argv[++i];
+        } else if (arg == "--png-level" && i + 1 < argc) {
+            setPngCompressionLevel(std::stoi(argv[++i]));
+        } else if (!parseConvertOption(argc, argv, i, options)) {
+            printUsage();
+            return 1;
+        }
+    }
+
+    const std::string in_ext = mode == "bmx2png" ? ".bmx" : ".png";
+    const std::string out_ext = mode == "bmx2png" ? ".png" : ".bmx";
+
+    std::vector<std::filesystem::path> inputs;
+    for (const auto& entry : std::filesystem::directory_iterator(input_dir)) {
+        if (entry.is_regular_file() && entry.path().extension() == in_ext)
+            inputs.push_back(entry.path());
+    }
+    std::sort(inputs.begin(), inputs.end());
+    std::filesystem::create_directories(output_dir);
+
+    if (!trace_file.empty()) setTraceEnabled(true);
+
+    ThreadPool pool(jobs);
+    std::vector<std::string> errors(inputs.size());
+    std::vector<ConvertStats> stats(inputs.size());
+    const auto start = std::chrono::steady_clock::now();
+
+    parallelFor(pool, inputs.size(), [&](const size_t i) {
+        const auto& input = inputs[i];
+        const std::string output = (output_dir / input.stem()).string() + out_ext;
+        TraceLabel label(input.filename().string());
+        TraceScope trace("file");
+
+        try {
+            if (mode == "bmx2png") {
+                BmxHeader info{};
+                const auto bitData = LoadBMX(input.string(), info);
+                writeOutput(output, encodePackedPNG(bitData, info.width, info.height));
+            } else if (options.sizes.size() > 1) {
+                std::vector<ConvertStats> sized_stats;
+                for (const auto& file : convertImageToBMXAtSizes(readFile(input.string()), options, &sized_stats))
+                    if (!writeFile(sizedPath(output, file), file)) errors[i] = "write failed";
+                // Totals over the sizes; the threshold is the first size's.
+                stats[i] = sized_stats.front();
+                for (size_t s = 1; s < sized_stats.size(); ++s) {
+                    stats[i].pixels_flipped += sized_stats[s].pixels_flipped;
+                    stats[i].bytes_saved += sized_stats[s].bytes_saved;
+                }
+            } else if (!convertImageToBM(input.string(), output, options, &stats[i])) {
+                errors[i] = "conversion failed";
+            }
+        } catch (const std::exception& e) {
+            errors[i] = e.what();
+        }
+    });
+
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t failed = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (errors[i].empty()) continue;
+        std::cerr << "Failed: " << inputs[i].string() << ": " << errors[i] << "\n";
+        ++failed;
+    }
+
+    std::cout << "Converted " << inputs.size() - failed << "/" << inputs.size() << " files in " << elapsed
+              << " ms using " << pool.size() << " threads\n";
+
+    if (mode == "png2bmx" && options.threshold == AUTO_THRESHOLD && options.dither == DitherMode::None) {
+        std::vector<int> thresholds;
+        for (size_t i = 0; i < inputs.size(); ++i)
+            if (errors[i].empty()) thresholds.push_back(stats[i].threshold);
+        if (!thresholds.empty()) {
+            std::sort(thresholds.begin(), thresholds.end());
+            std::cout << "Auto threshold: min " << thresholds.front() << ", median " << thresholds[thresholds.size() / 2]
+                      << ", max " << thresholds.back() << "\n";
+        }
+    }
+    if (mode == "png2bmx" && options.max_flips > 0) {
+        size_t flipped = 0, saved = 0;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (!errors[i].empty()) continue;
+            flipped += stats[i].pixels_flipped;
+            saved += stats[i].bytes_saved;
+        }
+        std::cout << "Pixel flips: " << flipped << " pixels changed, " << saved << " bytes saved\n";
+    }
+
+    if (!trace_file.empty()) {
+        setTraceEnabled(false);
+        if (!writeTrace(trace_file)) throw std::runtime_error("Failed to write trace: " + trace_file);
+        std::cout << "Saved trace as " << trace_file << "\n";
+    }
+
+    return failed == 0 ? 0 : 1;
 }
 
 int main(int argc, char** argv) {
-    if (argc < 3) {
+    // check and serve are the only commands that run without arguments.
+    if (argc < 2 || (argc < 3 && std::string(argv[1]) != "check" && std::string(argv[1]) != "serve")) {
         printUsage();
         return 1;
     }
@@ -21,33 +257,120 @@ int main(int argc, char** argv) {
     std::string command = argv[1];
 
     try {
+        if (int exit_code = 0; forwardToDaemon(argc, argv, exit_code)) {
+            return exit_code;
+        }
+
         if (command == "bmx2png") {
-            const std::string input_file = argv[2];
-            const std::string output_file = (argc > 3) ? argv[3] : std::filesystem::path(input_file).stem().string() + ".png";
+            const std::string output_file = outputPath(argc, argv, ".png");
+            // Keep stdout clean for the image when it is the output.
+            std::ostream& log = output_file == "-" ? std::cerr : std::cout;
 
             BmxHeader info{};
-            const auto bitData = LoadBMX(input_file, info);
-            const auto pixels = expandBitData(bitData, info.width, info.height);
+            const auto bitData = decodeBMX(readInput(argv[2]), info);
 
-            std::cout << "width: " << info.width << " height: " << info.height << std::endl;
-            std::cout << "is compressed: " << (info.is_compressed ? "true" : "false") << std::endl;
+            log << "width: " << info.width << " height: " << info.height << std::endl;
+            log << "is compressed: " << (info.is_compressed ? "true" : "false") << std::endl;
 
-            if (!stbi_write_png(output_file.c_str(), static_cast<int>(info.width), static_cast<int>(info.height), 1, pixels.data(), info.width)) {
-                throw std::runtime_error("Failed to write PNG");
-            }
+            writeOutput(output_file, encodePackedPNG(bitData, info.width, info.height));
 
-            std::cout << "Saved PNG as " << output_file << "\n";
+            log << "Saved PNG as " << output_file << "\n";
 
         } else if (command == "png2bmx") {
-            const std::string input_file = argv[2];
-            const std::string output_file = (argc > 3) ? argv[3] : std::filesystem::path(input_file).stem().string() + ".bmx";
+            const std::string output_file = outputPath(argc, argv, ".bmx");
+            std::ostream& log = output_file == "-" ? std::cerr : std::cout;
 
-            if (!convertImageToBM(input_file, output_file)) {
-                std::cerr << "Conversion failed\n";
-                return 1;
+            ConvertOptions options;
+            for (int i = argc > 3 && !isOption(argv[3]) ? 4 : 3; i < argc; ++i) {
+                if (!parseConvertOption(argc, argv, i, options)) {
+                    std::cerr << "Unknown png2bmx option: " << argv[i] << "\n";
+                    return 1;
+                }
             }
 
-            std::cout << "Converted PNG to BMX: " << output_file << "\n";
+            if (options.sizes.size() > 1) {
+                if (output_file == "-") {
+                    std::cerr << "Several --resize sizes need a file output\n";
+                    return 1;
+                }
+                std::vector<ConvertStats> stats;
+                const auto files = convertImageToBMXAtSizes(readInput(argv[2]), options, &stats);
+                for (size_t s = 0; s < files.size(); ++s) {
+                    const std::string sized_file = sizedPath(output_file, files[s]);
+                    writeOutput(sized_file, files[s]);
+                    if (options.threshold == AUTO_THRESHOLD && options.dither == DitherMode::None)
+                        log << "Auto threshold: " << stats[s].threshold << "\n";
+                    if (options.max_flips > 0)
+                        log << "Pixel flips: " << stats[s].pixels_flipped << " pixels changed, " << stats[s].bytes_saved << " bytes saved\n";
+                    log << "Converted PNG to BMX: " << sized_file << "\n";
+                }
+                return 0;
+            }
+
+            ConvertStats stats;
+            writeOutput(output_file, convertImageToBMX(readInput(argv[2]), options, &stats));
+
+            if (options.threshold == AUTO_THRESHOLD && options.dither == DitherMode::None)
+                log << "Auto threshold: " << stats.threshold << "\n";
+            if (options.max_flips > 0)
+                log << "Pixel flips: " << stats.pixels_flipped << " pixels changed, " << stats.bytes_saved << " bytes saved\n";
+            log << "Converted PNG to BMX: " << output_file << "\n";
+
+        } else if (command == "pbm2bmx") {
+            const std::string output_file = outputPath(argc, argv, ".bmx");
+            std::ostream& log = output_file == "-" ? std::cerr : std::cout;
+
+            uint32_t width, height;
+            const auto bitData = decodePBM(readInput(argv[2]), width, height);
+            writeOutput(output_file, encodePackedBMX(bitData, width, height));
+
+            log << "Converted PBM to BMX: " << output_file << "\n";
+
+        } else if (command == "bmx2pbm") {
+            const std::string output_file = outputPath(argc, argv, ".pbm");
+            std::ostream& log = output_file == "-" ? std::cerr : std::cout;
+
+            BmxHeader info{};
+            const auto bitData = decodeBMX(readInput(argv[2]), info);
+            writeOutput(output_file, encodePBM(bitData, info.width, info.height));
+
+            log << "Saved PBM as " << output_file << "\n";
+
+        } else if (command == "png2bm") {
+            return runPng2Bm(argc, argv);
+
+        } else if (command == "batch") {
+            return runBatch(argc, argv);
+
+        } else if (command == "bench") {
+            return runBench(argc, argv);
+
+        } else if (command == "check") {
+            return runCheck(argc, argv);
+
+        } else if (command == "analyze") {
+            return runAnalyze(argc, argv);
+
+        } else if (command == "sweep") {
+            return runSweep(argc, argv);
+
+        } else if (command == "codegen") {
+            return runCodegen(argc, argv);
+
+        } else if (command == "probe") {
+            return runProbe(argc, argv);
+
+        } else if (command == "serve") {
+            return runServe(argc, argv);
+
+        } else if (command == "ingest") {
+            return runIngest(argc, argv);
+
+        } else if (command == "gif2anim") {
+            return runGif2Anim(argc, argv);
+
+        } else if (command == "anim2apng") {
+            return runAnim2Apng(argc, argv);
 
         } else {
             printUsage();
@@ -0,0 +1,197 @@
+#include "commands.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bm_utils.h"
+#include "thread_pool.h"
+
+namespace {
+    struct CodecParams {
+        uint8_t window_bits;
+        uint8_t lookahead_bits;
+    };
+
+    struct SweepResult {
+        size_t compressed_size = 0;
+        size_t stored_size = 0; // what writeBmx would store: compressed only when smaller
+        double encode_ms = 0;
+        double decode_ms = 0;
+    };
+
+    // Every pair is timed through the heatshrink C library so the rows compare
+    // like with like. Writes run the default pair through HeatshrinkCodec
+    // instead (compressHeatshrink's fast path); it is timed separately.
+    using CodecFunction = std::vector<uint8_t> (*)(const uint8_t*, size_t, uint8_t, uint8_t);
+    struct Implementation {
+        const char* name;
+        CodecFunction compress;
+        CodecFunction decompress;
+    };
+    constexpr Implementation LIBRARY{"heatshrink library", compressHeatshrinkLibrary, decompressHeatshrinkLibrary};
+    constexpr Implementation CODEC{"HeatshrinkCodec", compressHeatshrink, decompressHeatshrink};
+
+    struct Asset {
+        std::string path;
+        std::vector<uint8_t> bits;
+    };
+
+    std::vector<CodecParams> legalParams() {
+        std::vector<CodecParams> params;
+        for (uint8_t w = MIN_WINDOW_BITS; w <= MAX_WINDOW_BITS; ++w)
+            for (uint8_t l = MIN_LOOKAHEAD_BITS; l < w; ++l)
+                params.push_back({w, l});
+        return params;
+    }
+
+    void collectAssets(const std::filesystem::path& path, std::vector<std::string>& inputs) {
+        if (!std::filesystem::is_directory(path)) {
+            inputs.push_back(path.string());
+            return;
+        }
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+            const auto ext = entry.path().extension();
+            if (entry.is_regular_file() && (ext == ".bmx" || ext == ".bm"))
+                inputs.push_back(entry.path().string());
+        }
+    }
+
+    std::vector<uint8_t> loadBits(const std::string& path) {
+        if (std::filesystem::path(path).extension() == ".bm") return decodeBM(readFile(path));
+        BmxHeader info{};
+        return LoadBMX(path, info);
+    }
+
+    SweepResult measure(const std::vector<uint8_t>& bits, const CodecParams& params, const Implementation& codec = LIBRARY) {
+        using clock = std::chrono::steady_clock;
+        SweepResult result;
+
+        const auto encode_start = clock::now();
+        const auto compressed = codec.compress(bits.data(), bits.size(), params.window_bits, params.lookahead_bits);
+        const auto decode_start = clock::now();
+        const auto decoded = codec.decompress(compressed.data(), compressed.size(), params.window_bits, params.lookahead_bits);
+        const auto decode_end = clock::now();
+
+        if (decoded != bits)
+            throw std::runtime_error("Round trip mismatch at window " + std::to_string(params.window_bits) +
+                                     ", lookahead " + std::to_string(params.lookahead_bits));
+
+        result.compressed_size = compressed.size();
+        result.stored_size = std::min(compressed.size(), bits.size());
+        result.encode_ms = std::chrono::duration<double, std::milli>(decode_start - encode_start).count();
+        result.decode_ms = std::chrono::duration<double, std::milli>(decode_end - decode_start).count();
+        return result;
+    }
+
+    std::string paramLabel(const CodecParams& params) {
+        return std::to_string(params.window_bits) + "/" + std::to_string(params.lookahead_bits);
+    }
+}
+
+int runSweep(const int argc, char** argv) {
+    std::vector<std::string> paths;
+    size_t jobs = 0;
+    size_t top = 10;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--jobs" && i + 1 < argc) jobs = std::stoul(argv[++i]);
+        else if (arg == "--top" && i + 1 < argc) top = std::stoul(argv[++i]);
+        else collectAssets(arg, paths);
+    }
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty()) {
+        std::cerr << "Usage: tool sweep <file.bmx|file.bm|dir>... [--jobs N] [--top N]\n";
+        return 1;
+    }
+
+    std::vector<Asset> assets(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) assets[i] = {paths[i], loadBits(paths[i])};
+
+    const auto params = legalParams();
+    const size_t default_index = std::find_if(params.begin(), params.end(), [](const CodecParams& p) {
+        return p.window_bits == WINDOW_BITS && p.lookahead_bits == LOOKAHEAD_BITS;
+    }) - params.begin();
+
+    ThreadPool pool(jobs);
+    std::cout << "Sweeping " << assets.size() << " assets x " << params.size() << " (window, lookahead) pairs on "
+              << pool.size() << " threads\n";
+
+    // results[asset * params.size() + param]
+    std::vector<SweepResult> results(assets.size() * params.size());
+    parallelFor(pool, results.size(), [&](const size_t task) {
+        results[task] = measure(assets[task / params.size()].bits, params[task % params.size()]);
+    });
+
+    std::cout << "\nBest pair per asset (smallest stored size, smaller window on ties):\n"
+              << std::setw(8) << "raw" << std::setw(8) << "best" << std::setw(8) << "pair"
+              << std::setw(8) << paramLabel(params[default_index]) << "  file\n";
+    for (size_t a = 0; a < assets.size(); ++a) {
+        const SweepResult* row = &results[a * params.size()];
+        size_t best = 0;
+        for (size_t p = 1; p < params.size(); ++p)
+            if (row[p].stored_size < row[best].stored_size) best = p;
+
+        std::cout << std::setw(8) << assets[a].bits.size() << std::setw(8) << row[best].stored_size
+                  << std::setw(8) << (row[best].compressed_size < assets[a].bits.size() ? paramLabel(params[best]) : "raw") << std::setw(8) << row[default_index].stored_size
+                  << "  " << assets[a].path << "\n";
+    }
+
+    struct CorpusTotal {
+        size_t param;
+        size_t stored_size = 0;
+        double encode_ms = 0;
+        double decode_ms = 0;
+    };
+    std::vector<CorpusTotal> totals(params.size());
+    for (size_t p = 0; p < params.size(); ++p) {
+        totals[p].param = p;
+        for (size_t a = 0; a < assets.size(); ++a) {
+            const auto& r = results[a * params.size() + p];
+            totals[p].stored_size += r.stored_size;
+            totals[p].encode_ms += r.encode_ms;
+            totals[p].decode_ms += r.decode_ms;
+        }
+    }
+    const CorpusTotal baseline = totals[default_index];
+    std::stable_sort(totals.begin(), totals.end(), [](const CorpusTotal& a, const CorpusTotal& b) {
+        return a.stored_size < b.stored_size;
+    });
+
+    std::cout << "\nCorpus totals (top " << std::min(top, totals.size()) << " pairs by stored size):\n"
+              << std::setw(8) << "pair" << std::setw(10) << "bytes" << std::setw(13) << ("vs " + paramLabel(params[default_index]))
+              << std::setw(12) << "encode ms" << std::setw(12) << "decode ms" << "\n";
+    for (size_t i = 0; i < std::min(top, totals.size()); ++i) {
+        const auto& t = totals[i];
+        const double delta = 100.0 * (static_cast<double>(t.stored_size) - static_cast<double>(baseline.stored_size)) /
+                             static_cast<double>(std::max<size_t>(baseline.stored_size, 1));
+        std::cout << std::setw(8) << paramLabel(params[t.param]) << std::setw(10) << t.stored_size
+                  << std::setw(12) << std::fixed << std::setprecision(1) << std::showpos << delta << "%" << std::noshowpos
+                  << std::setw(12) << std::setprecision(2) << t.encode_ms << std::setw(12) << t.decode_ms << "\n";
+    }
+
+    // The default pair once more through the codec writes actually use.
+    std::vector<SweepResult> codec_results(assets.size());
+    parallelFor(pool, assets.size(), [&](const size_t a) { codec_results[a] = measure(assets[a].bits, params[default_index], CODEC); });
+    CorpusTotal codec_total{default_index};
+    for (const auto& r : codec_results) {
+        codec_total.stored_size += r.stored_size;
+        codec_total.encode_ms += r.encode_ms;
+        codec_total.decode_ms += r.decode_ms;
+    }
+    std::cout << "\n" << paramLabel(params[default_index]) << " by implementation (rows above time the library for every pair):\n"
+              << std::left << std::setw(22) << "" << std::right << std::setw(10) << "bytes" << std::setw(12) << "encode ms"
+              << std::setw(12) << "decode ms" << "\n";
+    for (const auto& [implementation, total] : {std::pair{&LIBRARY, baseline}, std::pair{&CODEC, codec_total}}) {
+        std::cout << std::left << std::setw(22) << implementation->name << std::right << std::setw(10) << total.stored_size
+                  << std::setw(12) << std::setprecision(2) << total.encode_ms << std::setw(12) << total.decode_ms << "\n";
+    }
+
+    std::cout << "\nBest corpus pair: " << paramLabel(params[totals.front().param]) << " (" << totals.front().stored_size
+              << " bytes, current " << paramLabel(params[default_index]) << ": " << baseline.stored_size << " bytes)\n";
+    return 0;
+}